@@ -25,12 +25,16 @@
  * conversion used when generating the random strings.
  */
 
+#ifndef AUXILIARY_H
+#define AUXILIARY_H
+
 /* this feature test macro enables the st_blksize member of the struct stat */
 #define _XOPEN_SOURCE 500
 /* a feature test macro, which enables the support for large files (> 2 GiB) */
 #define _FILE_OFFSET_BITS 64
 
 #include "randomc.h"
+#include "sfmt.h"
 
 #include <cerrno>
 #include <cstdio>
@@ -40,6 +44,7 @@
 #include <iostream>
 #include <iomanip>
 #include <map>
+#include <pthread.h>
 #include <stdexcept>
 #include <fcntl.h>
 #include <sys/types.h>
@@ -48,7 +53,10 @@
 /* simple typedefs */
 
 typedef std::map<wchar_t, size_t> occurrences_map;
-typedef std::map<size_t, wchar_t> probability_map;
+
+/* forward declarations */
+
+class distribution;
 
 /* auxiliary exception class */
 
@@ -60,22 +68,76 @@ public:
 
 /* class */
 
+/**
+ * The pseudorandom number generator.
+ * The instance is shared by the program, except for the threads,
+ * which have asked for their local instances. The get_instance
+ * member function returns the local instance of the calling thread,
+ * if it has one. All the instances are seeded by the same seed
+ * and they can be reseeded for every block of the output,
+ * so that the output does not depend on the thread generating it.
+ */
 class rsgen {
 public:
+	static void set_seed (unsigned int seed);
 	static rsgen *instance (const int prng_type);
 	static rsgen *get_instance ();
+	static rsgen *local_instance ();
 	unsigned int next ();
+	void fill (unsigned int *numbers, size_t count);
+	void reseed (size_t block, unsigned int stream);
 private:
 	rsgen (const int prng_type);
 	rsgen (const rsgen &rhs);
 	rsgen &operator= (const rsgen &rhs);
 	virtual ~rsgen ();
+	static void destroy_local_instance (void *instance);
 	static rsgen *my_instance;
+	/* the local instance of the thread, if any */
+	static __thread rsgen *thread_instance;
+	/* the key used to destroy the local instances */
+	static pthread_key_t thread_key;
+	/* the thread, which uses the shared instance */
+	static pthread_t main_thread;
+	static unsigned int seed;
 	CRandomMersenne *mprng;
+	CRandomSFMT *sprng;
 	int ufd;
 	int prng_type;
 };
 
+/**
+ * A histogram of character occurrences.
+ * The characters from the Basic Multilingual Plane (BMP) are counted
+ * in a dense array, while the characters from the higher planes
+ * are counted in a sparse std::map. The dense array is split
+ * into several interleaved sub-histograms, so that the runs
+ * of the same character do not stall on a single counter.
+ * The sub-histograms are only summed up when the histogram is folded
+ * into the occurrences_map.
+ */
+class character_histogram {
+public:
+	character_histogram ();
+	virtual ~character_histogram ();
+	void add (const wchar_t *wbuffer, size_t wbuffer_size);
+	void add_bytes (const unsigned char *bytes, size_t size);
+	void merge (const character_histogram &rhs);
+	size_t fold (occurrences_map &occurrences) const;
+private:
+	character_histogram (const character_histogram &rhs);
+	character_histogram &operator= (const character_histogram &rhs);
+	void add_single (wchar_t c, size_t lane);
+	/* the number of the interleaved sub-histograms */
+	static const size_t lanes = 4;
+	/* the number of characters in the BMP */
+	static const size_t dense_size = 65536;
+	/* lanes * dense_size counters of the BMP characters */
+	size_t *dense;
+	/* the counters of the characters outside the BMP */
+	occurrences_map sparse;
+};
+
 
 int text_file_read_buffer (int fd,
 		char *buffer,
@@ -94,10 +156,12 @@ int convert_to_wbuffer (iconv_t *cd,
 		size_t output_buffer_size,
 		size_t *unused_input_bytes,
 		size_t *written_characters);
-int add_character_occurrences(occurrences_map &occurrences,
+int add_character_occurrences(character_histogram &histogram,
 		wchar_t *wbuffer,
 		size_t wbuffer_size);
 int fill_output_wbuffer (wchar_t *wbuffer,
 		size_t wbuffer_size,
-		const probability_map &pmap,
+		const distribution &dist,
 		double scale_factor);
+
+#endif /* AUXILIARY_H */
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator distribution cache.
+ * This file contains the declarations of functions,
+ * which are used to store the distribution built from a corpus
+ * in a cache file and to map it back into memory.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "auxiliary.h"
+#include "corpus.h"
+#include "distribution.h"
+
+#include <cstdlib>
+#include <string>
+
+int distribution_cache_path (const char *cache_directory,
+		const corpus_file_list &files,
+		const char *input_encoding,
+		std::string &cache_path);
+int load_distribution_cache (const std::string &cache_path,
+		const corpus_file_list &files,
+		const char *input_encoding,
+		size_t thread_count,
+		distribution &dist);
+int store_distribution_cache (const char *cache_directory,
+		const std::string &cache_path,
+		const corpus_file_list &files,
+		const char *input_encoding,
+		size_t thread_count,
+		const distribution &dist);
+
+#endif /* CACHE_H */
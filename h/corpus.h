@@ -0,0 +1,70 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator corpus file functions.
+ * This file contains the declarations of functions,
+ * which are used to expand the input file arguments
+ * into the list of corpus files and to ingest several
+ * corpus files concurrently.
+ */
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include "auxiliary.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/* the path of the corpus file, which stands for the standard input */
+static const char corpus_standard_input[] = "-";
+
+/* the size of a corpus file, which is not known in advance */
+static const size_t corpus_unknown_size = (size_t)(-1);
+
+/* a single file of the corpus */
+struct corpus_file {
+	std::string path;
+	/*
+	 * the size of the file in bytes, as reported by the stat,
+	 * or corpus_unknown_size if it is not known in advance,
+	 * like the size of a pipe
+	 */
+	size_t size;
+};
+
+/* simple typedefs */
+
+typedef std::vector<corpus_file> corpus_file_list;
+
+int open_corpus_file (const corpus_file &file);
+int close_corpus_file (const corpus_file &file, int fd);
+int expand_corpus_paths (const std::vector<const char *> &arguments,
+		corpus_file_list &files);
+int ingest_corpus_files (const corpus_file_list &files,
+		const char *input_encoding,
+		const char *internal_character_encoding,
+		size_t thread_count,
+		character_histogram &histogram,
+		size_t *total_characters);
+
+#endif /* CORPUS_H */
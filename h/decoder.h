@@ -0,0 +1,63 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator built-in decoders.
+ * This file contains the declarations of functions,
+ * which are used to decode the most common Unicode encodings
+ * and the ISO-8859-1 directly into a character histogram,
+ * without calling the iconv.
+ */
+
+#ifndef DECODER_H
+#define DECODER_H
+
+#include "auxiliary.h"
+
+#include <cstdlib>
+#include <string>
+
+/* the built-in decoders */
+enum builtin_decoder {
+	/* there is no built-in decoder, the iconv has to be used */
+	BUILTIN_DECODER_NONE = 0,
+	BUILTIN_DECODER_UTF8,
+	BUILTIN_DECODER_UTF16LE,
+	BUILTIN_DECODER_UTF16BE,
+	BUILTIN_DECODER_UCS2LE,
+	BUILTIN_DECODER_UCS2BE,
+	BUILTIN_DECODER_UCS4LE,
+	BUILTIN_DECODER_UCS4BE,
+	BUILTIN_DECODER_UTF32LE,
+	BUILTIN_DECODER_UTF32BE,
+	BUILTIN_DECODER_LATIN1,
+	BUILTIN_DECODER_ASCII
+};
+
+std::string normalize_encoding_name (const char *encoding);
+int select_builtin_decoder (const char *encoding);
+int decode_builtin (int decoder,
+		const char *input_buffer,
+		size_t input_buffer_size,
+		character_histogram &histogram,
+		size_t *unused_input_bytes,
+		size_t *characters);
+
+#endif /* DECODER_H */
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator corpus decompression.
+ * This file contains the declaration of the class,
+ * which decompresses a gzip- or xz-compressed input file
+ * on a separate thread.
+ */
+
+#ifndef DECOMPRESS_H
+#define DECOMPRESS_H
+
+#include "auxiliary.h"
+
+#include <cstdlib>
+#include <pthread.h>
+
+/* the compression formats of the input files */
+enum compression_format {
+	COMPRESSION_NONE = 0,
+	COMPRESSION_GZIP,
+	COMPRESSION_XZ
+};
+
+int detect_compression (const unsigned char *magic, size_t size);
+const char *compression_name (int format);
+
+/**
+ * A decompressor of a compressed input file.
+ * The input file is read and decompressed by a producer thread
+ * into a ring of buffers, while the consumer reads
+ * the decompressed data from the filled buffers. This way,
+ * the decompression overlaps with the decoding and counting
+ * of the characters.
+ */
+class decompressor {
+public:
+	decompressor ();
+	virtual ~decompressor ();
+	int start (int fd, int format, const char *prefix, size_t prefix_size);
+	int read (char *buffer, size_t buffer_size, size_t *bytes_read);
+	int finish ();
+private:
+	decompressor (const decompressor &rhs);
+	decompressor &operator= (const decompressor &rhs);
+	static void *producer_main (void *argument);
+	int produce ();
+	int inflate_gzip ();
+	int inflate_xz ();
+	char *acquire_buffer ();
+	void publish_buffer (size_t size);
+	int read_input (size_t *bytes_read);
+	/* the number of buffers in the ring */
+	static const size_t buffer_count = 4;
+	/* the size of a single buffer of decompressed data, 4 MiB */
+	static const size_t buffer_size = 4194304;
+	/* the size of the buffer of compressed data, 1 MiB */
+	static const size_t input_size = 1048576;
+	int fd;
+	int format;
+	char *buffers[buffer_count];
+	size_t sizes[buffer_count];
+	char *input;
+	/*
+	 * the number of the compressed bytes read by the caller
+	 * before the start, which are decompressed first
+	 */
+	size_t pending;
+	/* the index of the buffer to be read by the consumer */
+	size_t head;
+	/* the number of filled buffers */
+	size_t filled;
+	/* the read position in the head buffer */
+	size_t offset;
+	/* set by the producer when there is no more data */
+	int finished;
+	/* set by the producer in case of any error */
+	int failed;
+	/* set by the consumer when the producer should stop */
+	int stopped;
+	int started;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+};
+
+#endif /* DECOMPRESS_H */
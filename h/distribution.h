@@ -0,0 +1,77 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator character distribution.
+ * This file contains the declaration of the class,
+ * which holds the table used to pick the output characters
+ * according to the probability of their occurrences.
+ */
+
+#ifndef DISTRIBUTION_H
+#define DISTRIBUTION_H
+
+#include "auxiliary.h"
+
+#include <cstdlib>
+
+/**
+ * A probability distribution of the output characters.
+ * It consists of two parallel arrays: the symbols in the increasing
+ * order of their code points and the cumulative sums
+ * of their numbers of occurrences. The symbol i is picked
+ * for all the numbers from the interval
+ * (cumulative[i - 1], cumulative[i]].
+ * The arrays are either allocated by this object,
+ * or they point into a memory mapping owned by this object,
+ * like the one of a distribution cache file.
+ */
+class distribution {
+public:
+	distribution ();
+	virtual ~distribution ();
+	int build (const occurrences_map &occurrences);
+	void adopt_mapping (void *mapping,
+			size_t mapping_size,
+			const uint64_t *cumulative,
+			const uint32_t *symbols,
+			size_t symbol_count);
+	size_t size () const;
+	uint64_t total () const;
+	int uniform () const;
+	const uint64_t *cumulative () const;
+	const uint32_t *symbols () const;
+private:
+	distribution (const distribution &rhs);
+	distribution &operator= (const distribution &rhs);
+	void release ();
+	/* the arrays allocated by this object, if any */
+	uint64_t *owned_cumulative;
+	uint32_t *owned_symbols;
+	/* the memory mapping owned by this object, if any */
+	void *mapping;
+	size_t mapping_size;
+	/* the arrays in use */
+	const uint64_t *cumulative_table;
+	const uint32_t *symbol_table;
+	size_t symbol_count;
+};
+
+#endif /* DISTRIBUTION_H */
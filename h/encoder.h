@@ -0,0 +1,130 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator output encoder.
+ * This file contains the declarations of the class and functions,
+ * which are used to encode the generated characters
+ * without converting them by the iconv one by one.
+ */
+
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include "auxiliary.h"
+#include "distribution.h"
+
+#include <cstdlib>
+
+/**
+ * A table of the symbols of a distribution encoded
+ * in the output character encoding. Every symbol occupies
+ * a slot of slot_size bytes, so that it can be copied
+ * to the output buffer by a single fixed-size copy,
+ * after which the output position advances by its length.
+ * The table can only be built for the stateless encodings,
+ * in which the encoding of a string is the concatenation
+ * of the encodings of its characters.
+ *
+ * If every symbol is encoded in a single byte,
+ * the table of these bytes is also available, so that
+ * the symbol indices of small alphabets can be translated
+ * to the output by the byte shuffles.
+ */
+class symbol_encoder {
+public:
+	/* the size of the slot of a single encoded symbol */
+	static const size_t slot_size = 8;
+	/* the largest alphabet generated through the symbol indices */
+	static const size_t index_limit = 256;
+	/*
+	 * the byte counts up to this limit are checked one by one
+	 * whether they are sums of the lengths of the encoded symbols,
+	 * the larger ones only need to be multiples
+	 * of their greatest common divisor
+	 */
+	static const size_t reachable_limit = 128;
+	symbol_encoder ();
+	virtual ~symbol_encoder ();
+	static void enable_cache ();
+	int build (const distribution &dist,
+			const char *output_encoding,
+			const char *internal_character_encoding);
+	size_t size () const;
+	size_t max_length () const;
+	size_t fixed_length () const;
+	const unsigned char *slots () const;
+	const unsigned char *lengths () const;
+	const unsigned char *bytes () const;
+	const char *kernel () const;
+	int reachable (size_t bytes) const;
+private:
+	symbol_encoder (const symbol_encoder &rhs);
+	symbol_encoder &operator= (const symbol_encoder &rhs);
+	void release ();
+	void complete ();
+	/* the encoded symbols, slot_size bytes each */
+	unsigned char *slot_table;
+	/* the numbers of bytes of the encoded symbols */
+	unsigned char *length_table;
+	size_t symbol_count;
+	/* the length of the longest encoded symbol */
+	size_t longest;
+	/* the single-byte encoded symbols, if all of them are such */
+	unsigned char byte_table[index_limit];
+	/* the sums of the symbol lengths up to the reachable_limit */
+	unsigned char reachable_table[reachable_limit + 1];
+	/* the greatest common divisor of the symbol lengths */
+	size_t length_divisor;
+};
+
+int fill_output_buffer (char *buffer,
+		size_t characters,
+		const distribution &dist,
+		const symbol_encoder &encoder,
+		double scale_factor,
+		size_t *written_bytes);
+int uniform_sampling (const distribution &dist);
+int fill_output_uniform (char *buffer,
+		size_t skip,
+		size_t characters,
+		const symbol_encoder &encoder,
+		size_t *written_bytes);
+int fill_uniform_wbuffer (wchar_t *wbuffer,
+		size_t characters,
+		const distribution &dist);
+int fill_output_raw (char *buffer, size_t bytes);
+int fill_symbol_indices (uint32_t *indices,
+		size_t characters,
+		const distribution &dist,
+		double scale_factor);
+int fill_exact_tail (uint32_t *indices,
+		size_t *characters,
+		size_t *bytes,
+		size_t target_bytes,
+		const distribution &dist,
+		const symbol_encoder &encoder,
+		double scale_factor);
+char *encode_symbol_indices (const uint32_t *indices,
+		size_t count,
+		const symbol_encoder &encoder,
+		char *output);
+
+#endif /* ENCODER_H */
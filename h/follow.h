@@ -0,0 +1,112 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator corpus follower.
+ * This file contains the declaration of the class,
+ * which keeps the distribution up to date with the characters
+ * appended to a growing input file.
+ */
+
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+#include "auxiliary.h"
+#include "distribution.h"
+
+#include <cstdlib>
+#include <iconv.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+/**
+ * A follower of a growing input file.
+ * A background thread waits for the inotify events of the input file,
+ * decodes the newly appended characters and counts them.
+ * Then it builds a new distribution and publishes it
+ * by atomically replacing the published pointer.
+ *
+ * The generating thread picks up the published distribution
+ * by the acquire member function before each block. The pointer
+ * it returns is announced as being in use, so the follower
+ * only destroys the replaced distributions, which are neither
+ * published nor in use. This is a read-copy-update scheme
+ * with a single reader, whose quiescent states are
+ * the block boundaries.
+ */
+class corpus_follower {
+public:
+	corpus_follower ();
+	virtual ~corpus_follower ();
+	int start (const char *path,
+			int fd,
+			size_t offset,
+			const char *input_encoding,
+			const char *internal_character_encoding,
+			const occurrences_map &occurrences,
+			const distribution *initial);
+	const distribution *acquire ();
+	int stop ();
+	size_t updates () const;
+	size_t appended_characters () const;
+private:
+	corpus_follower (const corpus_follower &rhs);
+	corpus_follower &operator= (const corpus_follower &rhs);
+	static void *follower_main (void *argument);
+	int follow ();
+	int read_appended (int *changed);
+	int publish ();
+	void reclaim (int all);
+	/* the size of the buffer of the appended bytes, 1 MiB */
+	static const size_t buffer_size = 1048576;
+	/* the interval of checking whether to stop, in milliseconds */
+	static const int poll_interval = 100;
+	std::string path;
+	int fd;
+	int inotify_fd;
+	/* the offset of the first byte not read yet */
+	size_t offset;
+	/* the number of bytes of an incomplete character kept */
+	size_t unused;
+	char *buffer;
+	wchar_t *wbuffer;
+	int decoder;
+	iconv_t cd;
+	/* the occurrences in the input file at the start */
+	occurrences_map base;
+	/* the occurrences of the appended characters */
+	character_histogram *appended;
+	size_t appended_count;
+	size_t update_count;
+	/* the distribution built by the caller, never destroyed here */
+	const distribution *initial;
+	/* the published distribution */
+	const distribution *volatile published;
+	/* the distribution announced as being in use by the generator */
+	const distribution *volatile in_use;
+	/* the replaced distributions, which have not been destroyed yet */
+	std::vector<const distribution *> retired;
+	volatile int stopped;
+	int started;
+	pthread_t thread;
+};
+
+#endif /* FOLLOW_H */
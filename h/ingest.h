@@ -0,0 +1,106 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator corpus ingest functions.
+ * This file contains the declarations of functions,
+ * which are used to read the input file, decode its characters
+ * and count their occurrences on several threads.
+ */
+
+#ifndef INGEST_H
+#define INGEST_H
+
+#include "auxiliary.h"
+
+#include <cstdlib>
+#include <iconv.h>
+#include <map>
+
+/*
+ * The classes of the input character encodings.
+ * They determine how the input can be split into chunks,
+ * which start and end at the character boundaries.
+ */
+enum encoding_class {
+	/* the boundaries can not be determined, no splitting */
+	ENCODING_CLASS_OTHER = 0,
+	/* UTF-8, the boundary is any byte other than 10xxxxxx */
+	ENCODING_CLASS_UTF8,
+	/* UTF-16LE, two-byte units, but not a low surrogate */
+	ENCODING_CLASS_UTF16LE,
+	/* UTF-16BE, two-byte units, but not a low surrogate */
+	ENCODING_CLASS_UTF16BE,
+	/* single-byte encodings, every byte is a boundary */
+	ENCODING_CLASS_FIXED1,
+	/* fixed-width two-byte encodings */
+	ENCODING_CLASS_FIXED2,
+	/* fixed-width four-byte encodings */
+	ENCODING_CLASS_FIXED4,
+	/*
+	 * the EUC encodings, where the bytes below 0x80
+	 * are never a part of a multi-byte character
+	 */
+	ENCODING_CLASS_EUC,
+	/*
+	 * the double-byte encodings like GB18030, Shift_JIS or Big5,
+	 * where the bytes below 0x30 are never a part
+	 * of a multi-byte character
+	 */
+	ENCODING_CLASS_DBCS
+};
+
+/* simple typedefs */
+
+/* the half-widths of the confidence intervals of character frequencies */
+typedef std::map<wchar_t, double> confidence_map;
+
+int classify_encoding (const char *encoding);
+size_t find_character_boundary (int encoding_class,
+		const char *buffer,
+		size_t buffer_size,
+		size_t position);
+int decode_and_count (iconv_t *cd,
+		const char *input_buffer,
+		size_t input_buffer_size,
+		wchar_t *wbuffer,
+		size_t wbuffer_size,
+		character_histogram &histogram,
+		size_t *unused_input_bytes,
+		size_t *characters);
+int ingest_corpus_fd (int fd,
+		const char *input_encoding,
+		const char *internal_character_encoding,
+		size_t thread_count,
+		character_histogram &histogram,
+		size_t *total_characters,
+		size_t *total_bytes);
+int ingest_corpus_sample (int fd,
+		const char *input_encoding,
+		const char *internal_character_encoding,
+		size_t thread_count,
+		size_t sample_size,
+		unsigned int seed,
+		character_histogram &histogram,
+		size_t *total_characters,
+		size_t *sampled_bytes,
+		confidence_map &half_widths);
+
+#endif /* INGEST_H */
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file
+ * The pseudorandom string generator NUMA placement.
+ * This file contains the declarations of functions,
+ * which are used to discover the NUMA nodes, to pin the worker threads
+ * and the writer thread to them and to report the achieved placement.
+ */
+
+#ifndef NUMA_H
+#define NUMA_H
+
+#include "auxiliary.h"
+
+#include <cstdlib>
+#include <sched.h>
+
+/* constants */
+
+/* the node, which is not known */
+static const int numa_unknown_node = (-1);
+
+/* the number of worker indices, whose placement is recorded */
+static const size_t numa_recorded_workers = 64;
+
+/* the CPU affinity of a thread saved before it has been pinned */
+struct numa_affinity {
+	cpu_set_t mask;
+	/* nonzero if the mask has been saved */
+	int saved;
+};
+
+size_t numa_discover ();
+int numa_enable_placement ();
+void numa_disable_placement ();
+int numa_node_of_file (int fd);
+int numa_save_affinity (numa_affinity &affinity);
+int numa_restore_affinity (const numa_affinity &affinity);
+int numa_place_worker (size_t worker_index, size_t worker_count);
+int numa_place_writer (int fd);
+void numa_note_buffer (size_t worker_index, const void *buffer);
+int print_numa_topology ();
+int print_numa_placement ();
+
+#endif /* NUMA_H */
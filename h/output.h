@@ -0,0 +1,130 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator output files.
+ * This file contains the declarations of the class and functions,
+ * which are used to encode the generated characters
+ * and to write them to one or more output files.
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "auxiliary.h"
+#include "distribution.h"
+#include "encoder.h"
+
+#include <cstdlib>
+#include <iconv.h>
+#include <string>
+#include <vector>
+
+/**
+ * A single output file together with its character encoding.
+ * Every block of the generated characters is either generated
+ * directly into the output buffer, or encoded from the symbol indices
+ * shared by several output files. The symbols are encoded
+ * by the symbol encoder if possible, or by the iconv otherwise.
+ */
+class output_target {
+public:
+	output_target ();
+	virtual ~output_target ();
+	int open (const char *filename,
+			const char *encoding,
+			const char *internal_character_encoding,
+			size_t block_size);
+	int prepare (const distribution &dist);
+	int generate (const distribution &dist,
+			size_t characters,
+			double scale_factor);
+	int encode (const distribution &dist,
+			const uint32_t *indices,
+			size_t characters);
+	int flush ();
+	int resume (const distribution &dist,
+			double scale_factor,
+			size_t first);
+	int generate_ordered (const distribution &dist,
+			double scale_factor,
+			size_t first,
+			size_t characters,
+			size_t thread_count,
+			size_t buffer_count);
+	int generate_positioned (const distribution &dist,
+			double scale_factor,
+			size_t characters,
+			size_t thread_count);
+	int generate_mapped (const distribution &dist,
+			double scale_factor,
+			size_t characters,
+			size_t thread_count);
+	int generate_exact (const distribution &dist,
+			double scale_factor,
+			size_t output_bytes,
+			size_t thread_count,
+			size_t *characters);
+	int close ();
+	const char *filename () const;
+	const char *encoding () const;
+	const char *kernel () const;
+	size_t bytes_written () const;
+private:
+	output_target (const output_target &rhs);
+	output_target &operator= (const output_target &rhs);
+	int reserve (size_t size);
+	std::string path;
+	std::string target_encoding;
+	const char *internal_character_encoding;
+	int fd;
+	iconv_t cd;
+	/* the symbols of the distribution in the output encoding */
+	symbol_encoder encoder;
+	/* zero if the output is encoded by the symbol encoder */
+	int encoder_retval;
+	/* the distribution the symbol encoder has been built for */
+	const distribution *encoded_dist;
+	/* indicates whether the output is picked by the random bytes */
+	int uniform;
+	/* the maximum number of characters of a block */
+	size_t block_size;
+	wchar_t *wbuffer;
+	char *buffer;
+	size_t buffer_size;
+	/* the number of bytes of the encoded block not written yet */
+	size_t block_bytes;
+	size_t total_bytes;
+};
+
+/* simple typedefs */
+
+typedef std::vector<output_target *> output_target_list;
+
+int parse_output_specification (const char *specification,
+		std::string &encoding,
+		std::string &filename);
+int encode_output_targets (output_target_list &targets,
+		const distribution &dist,
+		const uint32_t *indices,
+		size_t characters,
+		size_t thread_count);
+
+#endif /* OUTPUT_H */
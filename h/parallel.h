@@ -0,0 +1,72 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator parallel execution functions.
+ * This file contains the declarations of functions,
+ * which are used to run independent tasks on several threads
+ * and to report how busy the threads have been.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "auxiliary.h"
+
+#include <cstdlib>
+
+/* constants */
+
+/* the number of worker indices, whose utilisation is recorded */
+static const size_t parallel_recorded_workers = 64;
+
+/* the utilisation of the worker threads with a given index */
+struct parallel_statistics {
+	/* the number of executed tasks */
+	size_t tasks;
+	/* the number of tasks taken from the other workers */
+	size_t stolen_tasks;
+	/* the time spent executing the tasks, in seconds */
+	double busy_seconds;
+	/* the time of the parallel runs the worker took part in */
+	double available_seconds;
+};
+
+/* simple typedefs */
+
+/*
+ * A task executed by the run_parallel function.
+ * The first argument is the shared context, the second one is the index
+ * of the task and the third one is the index of the worker thread
+ * executing it. The task returns zero on success and a positive
+ * error number otherwise.
+ */
+typedef int (*parallel_task) (void *context,
+		size_t task_index,
+		size_t worker_index);
+
+size_t available_processors ();
+size_t parallel_utilisation (parallel_statistics *statistics, size_t count);
+int run_parallel (parallel_task task,
+		void *context,
+		size_t task_count,
+		size_t thread_count);
+
+#endif /* PARALLEL_H */
@@ -72,6 +72,7 @@ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 *******************************************************************************/
 
+#include <string.h>                    // memcpy
 #include "sfmt.h"                      // Class definition and other declarations
 
 
@@ -274,6 +275,27 @@ uint32_t CRandomSFMT::BRandom() {
    return y;
 }
 
+void CRandomSFMT::BRandomFill(uint32_t * dest, size_t count) {
+   // Output count numbers of 32 random bits
+   size_t n;                           // Numbers copied from the state
+
+   if (UseMother) {
+      for (n = 0; n < count; n++) dest[n] = BRandom();
+      return;
+   }
+   while (count > 0) {
+      if (ix >= SFMT_N*4) {
+         Generate();
+      }
+      n = SFMT_N*4 - ix;
+      if (n > count) n = count;
+      memcpy(dest, (uint32_t*)state + ix, n * sizeof(uint32_t));
+      ix += (uint32_t)n;
+      dest += n;
+      count -= n;
+   }
+}
+
 uint32_t CRandomSFMT::MotherBits() {
    // Get random bits from Mother-Of-All generator
    uint64_t sum;
@@ -26,12 +26,16 @@
  */
 
 #include "auxiliary.h"
+#include "distribution.h"
+#include "encoder.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <exception>
 #include <iconv.h>
 #include <iostream>
@@ -40,19 +44,107 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 /* member functions */
 
+/**
+ * A member function which sets the seed of all the instances.
+ * It has to be called before the instances are created.
+ *
+ * @param
+ * seed		the seed
+ */
+void rsgen::set_seed (unsigned int seed) {
+	rsgen::seed = seed;
+}
+
+/**
+ * A member function which creates the shared instance
+ * of the specified type, seeded by the current seed.
+ * The previous shared instance, if any, is replaced,
+ * so that every output generated by the process
+ * starts from its own seed.
+ *
+ * @param
+ * prng_type	the type of the pseudorandom number generator
+ *
+ * @return	This function returns the shared instance.
+ */
 rsgen *rsgen::instance (const int prng_type = 1) {
-	static rsgen my_static_instance(prng_type);
-	if (my_instance == NULL) {
-		my_instance = &my_static_instance;
+	rsgen *previous = my_instance;
+	if (previous == NULL) {
+		main_thread = pthread_self();
+		pthread_key_create(&thread_key, destroy_local_instance);
 	}
+	my_instance = new rsgen(prng_type);
+	delete previous;
 	return (my_instance);
 }
 
 rsgen *rsgen::get_instance () {
-	return (my_instance);
+	return ((thread_instance != NULL) ? thread_instance : my_instance);
+}
+
+/**
+ * A member function which returns the local instance
+ * of the calling thread, creating it if necessary.
+ * The thread, which has created the shared instance, uses it.
+ * The local instance is destroyed when its thread exits.
+ *
+ * @return	This function returns the local instance.
+ */
+rsgen *rsgen::local_instance () {
+	if (thread_instance != NULL) {
+		return (thread_instance);
+	}
+	if (pthread_equal(pthread_self(), main_thread) != 0) {
+		return (my_instance);
+	}
+	thread_instance = new rsgen(my_instance->prng_type);
+	pthread_setspecific(thread_key, thread_instance);
+	return (thread_instance);
+}
+
+/**
+ * A function which destroys the local instance of an exiting thread.
+ *
+ * @param
+ * instance	the local instance
+ */
+void rsgen::destroy_local_instance (void *instance) {
+	delete (rsgen *)(instance);
+}
+
+/**
+ * A member function which reseeds this instance for the specified
+ * block of the output. The /dev/urandom system file
+ * can not be reseeded.
+ *
+ * @param
+ * block	the index of the block
+ * @param
+ * stream	the index of the independent stream of the block
+ */
+void rsgen::reseed (size_t block, unsigned int stream) {
+	int seeds[4];
+	seeds[0] = (int)(seed);
+	seeds[1] = (int)(block & 0xFFFFFFFFUL);
+	/* shifting twice, because size_t may only have 32 bits */
+	seeds[2] = (int)((block >> 16) >> 16);
+	seeds[3] = (int)(stream);
+	switch (prng_type) {
+		case 1 : /* Mersenne twister */
+			mprng->RandomInitByArray(seeds, 4);
+			break;
+		case 2 : /* the random() function */
+			srandom(seed ^ ((unsigned int)(block) * 2654435761U) ^
+					(stream << 16));
+			break;
+		case 4 : /* SIMD-oriented Fast Mersenne Twister */
+			sprng->RandomInitByArray(seeds, 4);
+			break;
+	}
 }
 
 unsigned int rsgen::next () {
@@ -77,6 +169,10 @@ unsigned int rsgen::next () {
 					(random()) + ((unsigned int)(1) << 31);
 			}
 			break;
+		case 4 : /* SIMD-oriented Fast Mersenne Twister */
+			pseudorandom_number = (unsigned int)
+				(sprng->BRandom());
+			break;
 		case 3 : /* the /dev/urandom system file */
 			read_retval = read(ufd,
 					&pseudorandom_number,
@@ -104,13 +200,68 @@ unsigned int rsgen::next () {
 	return (pseudorandom_number);
 }
 
-rsgen::rsgen (const int prng_type_arg = 1) : prng_type(prng_type_arg) {
+/**
+ * A member function which fills the array by the pseudorandom numbers.
+ * It selects the generator only once for the whole array
+ * and reads the /dev/urandom system file at once.
+ *
+ * @param
+ * numbers	the array of the pseudorandom numbers
+ * @param
+ * count	the number of the pseudorandom numbers
+ */
+void rsgen::fill (unsigned int *numbers, size_t count) {
+	char *position = (char *)(numbers);
+	size_t bytes_left = count * sizeof (unsigned int);
+	ssize_t read_retval = 0;
+	size_t i = 0;
 	switch (prng_type) {
 		case 1 : /* Mersenne twister */
-			mprng = new CRandomMersenne((int)(time(NULL)));
+			for (i = 0; i < count; ++i) {
+				numbers[i] = (unsigned int)
+					(mprng->BRandom());
+			}
+			break;
+		case 4 : /* SIMD-oriented Fast Mersenne Twister */
+			sprng->BRandomFill((uint32_t *)(numbers), count);
+			break;
+		case 3 : /* the /dev/urandom system file */
+			while (bytes_left > 0) {
+				read_retval = read(ufd, position, bytes_left);
+				if (read_retval == (-1)) {
+					perror("rsgen::fill(): read");
+					/* resetting the errno */
+					errno = 0;
+					throw my_exception();
+				} else if (read_retval == 0) {
+					throw my_exception();
+				}
+				position += read_retval;
+				bytes_left -= (size_t)(read_retval);
+			}
+			break;
+		default :
+			for (i = 0; i < count; ++i) {
+				numbers[i] = next();
+			}
+	}
+}
+
+rsgen::rsgen (const int prng_type_arg = 1) :
+		mprng(NULL),
+		sprng(NULL),
+		ufd(-1),
+		prng_type(prng_type_arg) {
+	switch (prng_type) {
+		case 1 : /* Mersenne twister */
+			mprng = new CRandomMersenne((int)(seed));
+			break;
+		case 4 : /* SIMD-oriented Fast Mersenne Twister */
+			/* without the Mother-Of-All generator for speed */
+			sprng = new CRandomSFMT((int)(seed), 0);
 			break;
 		case 2 : /* the random() function */
-			srandom((unsigned int)(time(NULL)));
+			srandom(seed);
 			break;
 		case 3 : /* the /dev/urandom system file */
 			/*
@@ -145,16 +296,175 @@ rsgen::~rsgen () {
 	 */
 	try {
 		delete mprng;
-		if (close(ufd) == -1) {
+		delete sprng;
+		if ((ufd != (-1)) && (close(ufd) == -1)) {
 			perror("/dev/urandom: close");
 		}
 	} catch (...) {
 	}
 }
 
+character_histogram::character_histogram () : dense(NULL) {
+	dense = new size_t[lanes * dense_size];
+	memset(dense, 0, lanes * dense_size * sizeof (size_t));
+}
+
+character_histogram::~character_histogram () {
+	delete[] dense;
+}
+
+/**
+ * A member function which adds the occurrences of the characters
+ * in the provided buffer of wide characters to this histogram.
+ *
+ * @param
+ * wbuffer	the buffer of wide characters
+ * @param
+ * wbuffer_size	the size of the input buffer of wide characters
+ */
+void character_histogram::add (const wchar_t *wbuffer,
+		size_t wbuffer_size) {
+	size_t *lane0 = dense;
+	size_t *lane1 = dense + dense_size;
+	size_t *lane2 = dense + 2 * dense_size;
+	size_t *lane3 = dense + 3 * dense_size;
+	unsigned long c0 = 0;
+	unsigned long c1 = 0;
+	unsigned long c2 = 0;
+	unsigned long c3 = 0;
+	size_t i = 0;
+	size_t j = 0;
+	/*
+	 * The four consecutive characters are counted
+	 * in the four different sub-histograms. If any of them
+	 * is outside the BMP, this group of characters
+	 * is counted one character at a time.
+	 */
+	for (; i + 4 <= wbuffer_size; i += 4) {
+		c0 = (unsigned long)(wbuffer[i]);
+		c1 = (unsigned long)(wbuffer[i + 1]);
+		c2 = (unsigned long)(wbuffer[i + 2]);
+		c3 = (unsigned long)(wbuffer[i + 3]);
+		if ((c0 | c1 | c2 | c3) < dense_size) {
+			++lane0[c0];
+			++lane1[c1];
+			++lane2[c2];
+			++lane3[c3];
+		} else {
+			for (j = i; j < i + 4; ++j) {
+				add_single(wbuffer[j], j % lanes);
+			}
+		}
+	}
+	for (; i < wbuffer_size; ++i) {
+		add_single(wbuffer[i], i % lanes);
+	}
+}
+
+/**
+ * A member function which adds the occurrences of the characters,
+ * whose code points are equal to the values of the provided bytes,
+ * to this histogram. This is the case of the ASCII
+ * and ISO-8859-1 (Latin-1) characters, which can therefore be
+ * counted without widening them to the wide characters first.
+ *
+ * @param
+ * bytes	the buffer of bytes
+ * @param
+ * size		the number of bytes in the buffer
+ */
+void character_histogram::add_bytes (const unsigned char *bytes,
+		size_t size) {
+	size_t *lane0 = dense;
+	size_t *lane1 = dense + dense_size;
+	size_t *lane2 = dense + 2 * dense_size;
+	size_t *lane3 = dense + 3 * dense_size;
+	size_t i = 0;
+	for (; i + 4 <= size; i += 4) {
+		++lane0[bytes[i]];
+		++lane1[bytes[i + 1]];
+		++lane2[bytes[i + 2]];
+		++lane3[bytes[i + 3]];
+	}
+	for (; i < size; ++i) {
+		++lane0[bytes[i]];
+	}
+}
+
+/**
+ * A member function which adds a single occurrence
+ * of the provided character to the specified sub-histogram.
+ *
+ * @param
+ * c	the character to be counted
+ * @param
+ * lane	the sub-histogram, in which the BMP character will be counted
+ */
+void character_histogram::add_single (wchar_t c, size_t lane) {
+	if ((unsigned long)(c) < dense_size) {
+		++dense[lane * dense_size + (unsigned long)(c)];
+	} else {
+		++sparse[c];
+	}
+}
+
+/**
+ * A member function which adds all the occurrences counted
+ * by the provided histogram to this histogram.
+ *
+ * @param
+ * rhs	the histogram to be merged into this histogram
+ */
+void character_histogram::merge (const character_histogram &rhs) {
+	for (size_t i = 0; i < lanes * dense_size; ++i) {
+		dense[i] += rhs.dense[i];
+	}
+	for (occurrences_map::const_iterator it = rhs.sparse.begin();
+			it != rhs.sparse.end(); ++it) {
+		sparse[it->first] += it->second;
+	}
+}
+
+/**
+ * A member function which sums up the sub-histograms
+ * and adds the resulting numbers of character occurrences
+ * to the provided occurrence map.
+ *
+ * @param
+ * occurrences	a std::map to which the numbers
+ * 		of character occurrences will be added
+ *
+ * @return	This function returns the total number
+ * 		of character occurrences in this histogram.
+ */
+size_t character_histogram::fold (occurrences_map &occurrences) const {
+	size_t total = 0;
+	size_t count = 0;
+	for (size_t c = 0; c < dense_size; ++c) {
+		count = 0;
+		for (size_t lane = 0; lane < lanes; ++lane) {
+			count += dense[lane * dense_size + c];
+		}
+		if (count > 0) {
+			occurrences[(wchar_t)(c)] += count;
+			total += count;
+		}
+	}
+	for (occurrences_map::const_iterator it = sparse.begin();
+			it != sparse.end(); ++it) {
+		occurrences[it->first] += it->second;
+		total += it->second;
+	}
+	return (total);
+}
+
 /* static private member variables */
 
 rsgen *rsgen::my_instance = NULL;
+__thread rsgen *rsgen::thread_instance = NULL;
+pthread_key_t rsgen::thread_key;
+pthread_t rsgen::main_thread;
+unsigned int rsgen::seed = 0;
 
 /* regular functions */
 
@@ -185,25 +495,33 @@ int text_file_read_buffer (int fd,
 		char *buffer,
 		size_t buffer_size,
 		size_t *bytes_read) {
-	ssize_t read_retval = read(fd, buffer, buffer_size);
-	/* we check whether the read has encountered an error */
-	if (read_retval == (-1)) {
-		perror("text_file_read_buffer: read");
-		/* resetting the errno */
-		errno = 0;
-		return (1); /* failure */
-	/* if we have reached the end of the input file */
-	} else if (read_retval == 0) {
-		(*bytes_read) = 0;
-		return (-1); /* partial success */
-	} else {
-		(*bytes_read) = (size_t)(read_retval);
-		if ((*bytes_read) < buffer_size) {
+	ssize_t read_retval = 0;
+	(*bytes_read) = 0;
+	/*
+	 * The pipes and other special files may return less bytes
+	 * than requested before their end is reached,
+	 * so we keep reading until the buffer is full.
+	 */
+	while ((*bytes_read) < buffer_size) {
+		read_retval = read(fd, buffer + (*bytes_read),
+				buffer_size - (*bytes_read));
+		/* we check whether the read has encountered an error */
+		if (read_retval == (-1)) {
+			if (errno == EINTR) {
+				errno = 0;
+				continue;
+			}
+			perror("text_file_read_buffer: read");
+			/* resetting the errno */
+			errno = 0;
+			return (1); /* failure */
+		/* if we have reached the end of the input file */
+		} else if (read_retval == 0) {
 			return (-1); /* partial success */
-		} else {
-			return (0); /* success */
 		}
+		(*bytes_read) += (size_t)(read_retval);
 	}
+	return (0); /* success */
 }
 
 /**
@@ -378,10 +696,10 @@ int convert_to_wbuffer (iconv_t *cd,
 /**
  * A function which scans the provided buffer of wide characters
  * and adds the numbers of their respective occurrences
- * to the provided occurrence map
+ * to the provided character histogram
  *
  * @param
- * occurrences	a std::map containing the current numbers
+ * histogram	a character_histogram containing the current numbers
  * 		of character occurrences
  * @param
  * wbuffer	the buffer of wide characters
@@ -390,25 +708,17 @@ int convert_to_wbuffer (iconv_t *cd,
  *
  * @return	This function always returns zero.
  */
-int add_character_occurrences(occurrences_map &occurrences,
+int add_character_occurrences(character_histogram &histogram,
 		wchar_t *wbuffer,
 		size_t wbuffer_size) {
-	size_t i = 0;
-	for (; i < wbuffer_size; ++i) {
-		/*
-		 * FIXME: We are strongly relying on
-		 * the size_t being initialized to zero!
-		 * How portable is this?
-		 */
-		++occurrences[wbuffer[i]];
-	}
+	histogram.add(wbuffer, wbuffer_size);
 	return (0);
 }
 
 /**
  * A function which fills the buffer of wide characters
  * with a random wide characters contained in
- * the provided probability_map pmap.
+ * the provided distribution.
  *
  * @param
  * wbuffer	the buffer of wide characters which will be used
@@ -417,7 +727,7 @@ int add_character_occurrences(occurrences_map &occurrences,
  * wbuffer_size	the desired number of wide characters
  * 		to output into the provided wbuffer
  * @param
- * pmap		the probability_map according to which
+ * dist		the distribution according to which
  * 		the random characters will be selected
  * @param
  * scale_factor	the number by which the generated random numbers
@@ -431,11 +741,17 @@ int add_character_occurrences(occurrences_map &occurrences,
  */
 int fill_output_wbuffer (wchar_t *wbuffer,
 		size_t wbuffer_size,
-		const probability_map &pmap,
+		const distribution &dist,
 		double scale_factor) {
-	/* an iterator to the provided probability_map */
-	probability_map::const_iterator it = pmap.begin();
+	const uint64_t *cumulative = dist.cumulative();
+	const uint64_t *cumulative_end = cumulative + dist.size();
+	const uint64_t *it = cumulative;
+	const uint32_t *symbols = dist.symbols();
 	unsigned int pseudorandom_number = 0;
+	/* the same characters as the ones of the symbol encoder */
+	if (uniform_sampling(dist) != 0) {
+		return (fill_uniform_wbuffer(wbuffer, wbuffer_size, dist));
+	}
 	try {
 		for (size_t i = 0; i < wbuffer_size; ++i) {
 			/*
@@ -453,13 +769,14 @@ int fill_output_wbuffer (wchar_t *wbuffer,
 			pseudorandom_number = (unsigned int)
 				((double)(pseudorandom_number) *
 				scale_factor + 1.5);
-			it = pmap.lower_bound(pseudorandom_number);
-			if (it == pmap.end()) {
-				std::cerr << "pmap.lower_bound() "
-					"returned pmap.end()\n";
+			it = std::lower_bound(cumulative, cumulative_end,
+					(uint64_t)(pseudorandom_number));
+			if (it == cumulative_end) {
+				std::cerr << "lower_bound() returned "
+					"the end of the distribution\n";
 				return (1);
 			}
-			wbuffer[i] = it->second;
+			wbuffer[i] = (wchar_t)(symbols[it - cumulative]);
 		}
 	} catch (...) {
 		std::cerr << "random character selection error!\n";
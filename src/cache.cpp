@@ -0,0 +1,704 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator distribution cache.
+ * This file contains the implementation of functions,
+ * which are used to store the distribution built from a corpus
+ * in a cache file and to map it back into memory.
+ *
+ * The cache file consists of a fixed-size header, the records
+ * of the corpus files, the array of the cumulative sums
+ * of the numbers of occurrences, the array of the symbols
+ * and the string pool containing the input encoding
+ * and the paths of the corpus files. All the numbers are stored
+ * in the native byte order, which is recorded in the header.
+ * The arrays are aligned, so that the distribution can use them
+ * directly from the memory mapping of the cache file.
+ */
+
+#include "cache.h"
+#include "parallel.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <vector>
+
+/* constants */
+
+/* the magic bytes at the beginning of every cache file */
+static const char cache_magic[8] = {'R', 'S', 'G', 'E', 'N', 'D', 'C', '\0'};
+/* the version of the cache file format */
+static const uint32_t cache_version = 1;
+/* the byte order mark, as it appears in the native byte order */
+static const uint32_t cache_byte_order = 0x01020304;
+/* the size of a block of a corpus file hashed by a single task, 4 MiB */
+static const size_t cache_hash_block_size = 4194304;
+/* the multipliers used by the content hash */
+static const uint64_t cache_hash_prime1 =
+	((uint64_t)(0x9E3779B1UL) << 32) | (uint64_t)(0x85EBCA87UL);
+static const uint64_t cache_hash_prime2 =
+	((uint64_t)(0xC2B2AE3DUL) << 32) | (uint64_t)(0x27D4EB4FUL);
+/* the multipliers used to mix the bits of the hash */
+static const uint64_t cache_mix_prime1 =
+	((uint64_t)(0xFF51AFD7UL) << 32) | (uint64_t)(0xED558CCDUL);
+static const uint64_t cache_mix_prime2 =
+	((uint64_t)(0xC4CEB9FEUL) << 32) | (uint64_t)(0x1A85EC53UL);
+
+/* auxiliary structures */
+
+/* the header of the cache file */
+struct cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	/* the size of the entire cache file */
+	uint64_t cache_size;
+	uint64_t file_count;
+	uint64_t symbol_count;
+	/* the total number of character occurrences */
+	uint64_t total;
+	/* the length of the input encoding at the start of the pool */
+	uint64_t encoding_length;
+	/* the offsets of the individual sections of the cache file */
+	uint64_t files_offset;
+	uint64_t cumulative_offset;
+	uint64_t symbols_offset;
+	uint64_t strings_offset;
+	uint64_t strings_size;
+};
+
+/* the record of a single corpus file */
+struct cache_file_record {
+	uint64_t size;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	uint64_t content_hash;
+	/* the position of the path in the string pool */
+	uint64_t path_offset;
+	uint64_t path_length;
+};
+
+/* the state shared by all the tasks hashing a single corpus file */
+struct hash_context {
+	const unsigned char *data;
+	size_t size;
+	/* the per-block hashes */
+	uint64_t *hashes;
+};
+
+/* static functions */
+
+/**
+ * A function which mixes the bits of the provided number.
+ *
+ * @param
+ * h	the number to mix
+ *
+ * @return	This function returns the mixed number.
+ */
+static inline uint64_t hash_mix (uint64_t h) {
+	h ^= h >> 33;
+	h *= cache_mix_prime1;
+	h ^= h >> 33;
+	h *= cache_mix_prime2;
+	h ^= h >> 33;
+	return (h);
+}
+
+/**
+ * A function which computes the 64-bit hash of the provided bytes.
+ *
+ * @param
+ * data		the bytes to hash
+ * @param
+ * size		the number of bytes
+ *
+ * @return	This function returns the hash of the bytes.
+ */
+static uint64_t hash_bytes (const unsigned char *data, size_t size) {
+	uint64_t h = (uint64_t)(size) * cache_hash_prime1;
+	uint64_t word = 0;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		memcpy(&word, data + i, 8);
+		h ^= hash_mix(word);
+		h = ((h << 29) | (h >> 35)) * cache_hash_prime2;
+	}
+	if (i < size) {
+		word = 0;
+		memcpy(&word, data + i, size - i);
+		h ^= hash_mix(word);
+		h = ((h << 29) | (h >> 35)) * cache_hash_prime2;
+	}
+	return (hash_mix(h));
+}
+
+/**
+ * A task which hashes a single block of a corpus file.
+ *
+ * @param
+ * context	a pointer to the hash_context structure
+ * @param
+ * task_index	the index of the block to hash
+ * @param
+ * worker_index	the index of the worker executing this task
+ *
+ * @return	This function always returns zero.
+ */
+static int hash_block_task (void *context,
+		size_t task_index,
+		size_t worker_index) {
+	hash_context *hc = (hash_context *)(context);
+	size_t offset = task_index * cache_hash_block_size;
+	size_t size = hc->size - offset;
+	(void)(worker_index);
+	if (size > cache_hash_block_size) {
+		size = cache_hash_block_size;
+	}
+	hc->hashes[task_index] = hash_bytes(hc->data + offset, size);
+	return (0);
+}
+
+/**
+ * A function which computes the content hash of a corpus file.
+ * The blocks of the file are hashed in parallel
+ * and the hashes of the blocks are then combined in their order,
+ * so the result does not depend on the number of threads.
+ *
+ * @param
+ * path		the path of the corpus file
+ * @param
+ * size		the size of the corpus file
+ * @param
+ * thread_count	the maximum number of threads to use
+ * @param
+ * content_hash	this variable will be set to the content hash
+ *
+ * @return	If the content hash has been successfully computed,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int hash_corpus_file (const std::string &path,
+		size_t size,
+		size_t thread_count,
+		uint64_t *content_hash) {
+	hash_context hc;
+	void *mapping = NULL;
+	size_t block_count = (size + cache_hash_block_size - 1) /
+		cache_hash_block_size;
+	size_t i = 0;
+	int fd = 0;
+	int retval = 0;
+	uint64_t h = (uint64_t)(size) * cache_hash_prime2;
+	if (size > 0) {
+		if ((fd = open(path.c_str(), O_RDONLY)) == (-1)) {
+			perror(path.c_str());
+			/* resetting the errno */
+			errno = 0;
+			return (1);
+		}
+		mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (mapping == MAP_FAILED) {
+			perror("hash_corpus_file: mmap");
+			/* resetting the errno */
+			errno = 0;
+			return (1);
+		}
+		madvise(mapping, size, MADV_SEQUENTIAL);
+		hc.data = (const unsigned char *)(mapping);
+		hc.size = size;
+		hc.hashes = NULL;
+		try {
+			hc.hashes = new uint64_t[block_count];
+		} catch (std::bad_alloc &) {
+			std::cerr << "hash_corpus_file: allocation error!\n";
+			retval = 1;
+		}
+		if (retval == 0) {
+			run_parallel(hash_block_task, &hc,
+					block_count, thread_count);
+			for (i = 0; i < block_count; ++i) {
+				h = hash_mix(h * cache_hash_prime1 +
+						hc.hashes[i]);
+			}
+		}
+		delete[] hc.hashes;
+		munmap(mapping, size);
+	}
+	(*content_hash) = h;
+	return (retval);
+}
+
+/**
+ * A function which determines the identity of the corpus files,
+ * that is their canonical paths, sizes and modification times.
+ * The content hashes are not computed.
+ *
+ * @param
+ * files	the corpus files
+ * @param
+ * paths	the canonical paths of the corpus files
+ * @param
+ * records	the records of the corpus files
+ *
+ * @return	If the identity of all the corpus files
+ * 		has been determined, this function returns zero.
+ * 		If any of the corpus files is not a regular file,
+ * 		this function returns (-1).
+ * 		Otherwise, in case of any error, it returns one (1).
+ */
+static int identify_corpus_files (const corpus_file_list &files,
+		std::vector<std::string> &paths,
+		std::vector<cache_file_record> &records) {
+	struct stat file_stat;
+	cache_file_record record;
+	char *resolved = NULL;
+	size_t i = 0;
+	for (i = 0; i < files.size(); ++i) {
+		/* the standard input has no path to identify it by */
+		if (files[i].path == corpus_standard_input) {
+			return (-1);
+		}
+		if (stat(files[i].path.c_str(), &file_stat) == (-1)) {
+			perror(files[i].path.c_str());
+			/* resetting the errno */
+			errno = 0;
+			return (1);
+		}
+		if (!S_ISREG(file_stat.st_mode)) {
+			return (-1);
+		}
+		if ((resolved = realpath(files[i].path.c_str(),
+						NULL)) == NULL) {
+			perror(files[i].path.c_str());
+			/* resetting the errno */
+			errno = 0;
+			return (1);
+		}
+		paths.push_back(resolved);
+		free(resolved);
+		memset(&record, 0, sizeof (record));
+		record.size = (uint64_t)(file_stat.st_size);
+		record.mtime_sec = (int64_t)(file_stat.st_mtim.tv_sec);
+		record.mtime_nsec = (int64_t)(file_stat.st_mtim.tv_nsec);
+		records.push_back(record);
+	}
+	return (0);
+}
+
+/**
+ * A function which checks whether the provided cache file mapping
+ * is a well-formed cache file of the current version.
+ *
+ * @param
+ * mapping	the memory mapping of the cache file
+ * @param
+ * mapping_size	the size of the cache file
+ *
+ * @return	If the cache file is well-formed,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int validate_cache (const char *mapping, size_t mapping_size) {
+	const cache_header *header = (const cache_header *)(mapping);
+	const uint64_t *cumulative = NULL;
+	uint64_t size = (uint64_t)(mapping_size);
+	uint64_t i = 0;
+	if ((mapping_size < sizeof (cache_header)) ||
+			(memcmp(header->magic, cache_magic,
+				sizeof (cache_magic)) != 0) ||
+			(header->version != cache_version) ||
+			(header->byte_order != cache_byte_order) ||
+			(header->cache_size != size) ||
+			(header->file_count > size) ||
+			(header->symbol_count > size) ||
+			(header->symbol_count == 0) ||
+			(header->files_offset > size) ||
+			(header->file_count * sizeof (cache_file_record) >
+			 size - header->files_offset) ||
+			((header->cumulative_offset % 8) != 0) ||
+			(header->cumulative_offset > size) ||
+			(header->symbol_count * 8 >
+			 size - header->cumulative_offset) ||
+			((header->symbols_offset % 4) != 0) ||
+			(header->symbols_offset > size) ||
+			(header->symbol_count * 4 >
+			 size - header->symbols_offset) ||
+			(header->strings_offset > size) ||
+			(header->strings_size > size - header->strings_offset) ||
+			(header->encoding_length > header->strings_size)) {
+		return (1);
+	}
+	cumulative = (const uint64_t *)(mapping + header->cumulative_offset);
+	for (i = 1; i < header->symbol_count; ++i) {
+		if (cumulative[i] <= cumulative[i - 1]) {
+			return (1);
+		}
+	}
+	if ((cumulative[0] == 0) ||
+			(cumulative[header->symbol_count - 1] !=
+			 header->total)) {
+		return (1);
+	}
+	return (0);
+}
+
+/* regular functions */
+
+/**
+ * A function which determines the path of the cache file
+ * for the provided corpus files and input encoding.
+ * The name of the cache file is derived from the hash
+ * of the input encoding and the canonical paths of the corpus files.
+ *
+ * @param
+ * cache_directory	the directory containing the cache files
+ * @param
+ * files	the corpus files
+ * @param
+ * input_encoding	the character encoding of the corpus files
+ * @param
+ * cache_path	this variable will be set to the path of the cache file
+ *
+ * @return	If the path of the cache file has been determined,
+ * 		this function returns zero.
+ * 		If the corpus can not be cached, because some of its files
+ * 		are not regular files, this function returns (-1).
+ * 		Otherwise, in case of any error, it returns one (1).
+ */
+int distribution_cache_path (const char *cache_directory,
+		const corpus_file_list &files,
+		const char *input_encoding,
+		std::string &cache_path) {
+	std::vector<std::string> paths;
+	std::vector<cache_file_record> records;
+	std::string key = input_encoding;
+	char name[32];
+	uint64_t key_hash = 0;
+	size_t i = 0;
+	int retval = 0;
+	if ((retval = identify_corpus_files(files, paths, records)) != 0) {
+		return (retval);
+	}
+	key += '\0';
+	for (i = 0; i < paths.size(); ++i) {
+		key += paths[i];
+		key += '\0';
+	}
+	key_hash = hash_bytes((const unsigned char *)(key.data()), key.size());
+	snprintf(name, sizeof (name), "%08lx%08lx.rsd",
+			(unsigned long)(key_hash >> 32),
+			(unsigned long)(key_hash & 0xFFFFFFFFUL));
+	cache_path = cache_directory;
+	if ((cache_path.empty()) ||
+			(cache_path[cache_path.size() - 1] != '/')) {
+		cache_path += '/';
+	}
+	cache_path += name;
+	return (0);
+}
+
+/**
+ * A function which maps the cache file into memory
+ * and, if it matches the corpus files and the input encoding,
+ * makes the provided distribution use the arrays stored in it.
+ * A corpus file matches its record if it has the same size
+ * and either the same modification time or the same content hash.
+ * In the latter case, the modification time stored in the cache file
+ * is updated, so that the content hash is not computed again.
+ *
+ * @param
+ * cache_path	the path of the cache file
+ * @param
+ * files	the corpus files
+ * @param
+ * input_encoding	the character encoding of the corpus files
+ * @param
+ * thread_count	the maximum number of threads used to compute
+ * 		the content hashes
+ * @param
+ * dist		the distribution
+ *
+ * @return	If the distribution has been loaded from the cache file,
+ * 		this function returns zero.
+ * 		Otherwise, if the cache file does not exist,
+ * 		is not valid or does not match the corpus files,
+ * 		this function returns (-1).
+ */
+int load_distribution_cache (const std::string &cache_path,
+		const corpus_file_list &files,
+		const char *input_encoding,
+		size_t thread_count,
+		distribution &dist) {
+	std::vector<std::string> paths;
+	std::vector<cache_file_record> records;
+	const cache_header *header = NULL;
+	const cache_file_record *stored = NULL;
+	const char *strings = NULL;
+	struct stat cache_stat;
+	char *mapping = NULL;
+	size_t mapping_size = 0;
+	size_t i = 0;
+	int fd = 0;
+	int update_fd = (-1);
+	int retval = 0;
+	if (identify_corpus_files(files, paths, records) != 0) {
+		return (-1);
+	}
+	if ((fd = open(cache_path.c_str(), O_RDONLY)) == (-1)) {
+		if (errno != ENOENT) {
+			perror(cache_path.c_str());
+		}
+		/* resetting the errno */
+		errno = 0;
+		return (-1);
+	}
+	if ((fstat(fd, &cache_stat) == (-1)) ||
+			(cache_stat.st_size < (off_t)(sizeof (cache_header)))) {
+		std::cerr << "Warning: The cache file '" << cache_path <<
+			"' is not valid!\n";
+		/* resetting the errno */
+		errno = 0;
+		close(fd);
+		return (-1);
+	}
+	mapping_size = (size_t)(cache_stat.st_size);
+	mapping = (char *)(mmap(NULL, mapping_size, PROT_READ,
+				MAP_SHARED, fd, 0));
+	if (mapping == MAP_FAILED) {
+		perror("load_distribution_cache: mmap");
+		/* resetting the errno */
+		errno = 0;
+		close(fd);
+		return (-1);
+	}
+	header = (const cache_header *)(mapping);
+	if (validate_cache(mapping, mapping_size) != 0) {
+		std::cerr << "Warning: The cache file '" << cache_path <<
+			"' is not valid!\n";
+		retval = (-1);
+	} else {
+		strings = mapping + header->strings_offset;
+		stored = (const cache_file_record *)
+			(mapping + header->files_offset);
+		if ((header->encoding_length != strlen(input_encoding)) ||
+				(memcmp(strings, input_encoding,
+					strlen(input_encoding)) != 0) ||
+				(header->file_count != records.size())) {
+			retval = (-1);
+		}
+	}
+	for (i = 0; (retval == 0) && (i < records.size()); ++i) {
+		if ((stored[i].path_offset > header->strings_size) ||
+				(stored[i].path_length !=
+				 paths[i].size()) ||
+				(stored[i].path_length >
+				 header->strings_size -
+				 stored[i].path_offset) ||
+				(memcmp(strings + stored[i].path_offset,
+					paths[i].data(),
+					paths[i].size()) != 0) ||
+				(stored[i].size != records[i].size)) {
+			retval = (-1);
+			break;
+		}
+		if ((stored[i].mtime_sec == records[i].mtime_sec) &&
+				(stored[i].mtime_nsec ==
+				 records[i].mtime_nsec)) {
+			continue;
+		}
+		/* the file has been touched, but it may be the same */
+		if ((hash_corpus_file(paths[i], (size_t)(records[i].size),
+				thread_count,
+				&(records[i].content_hash)) != 0) ||
+				(records[i].content_hash !=
+				 stored[i].content_hash)) {
+			retval = (-1);
+			break;
+		}
+		if (update_fd == (-1)) {
+			update_fd = open(cache_path.c_str(), O_WRONLY);
+		}
+		/* updating the cache file is not essential */
+		if ((update_fd == (-1)) || (pwrite(update_fd,
+				&(records[i].mtime_sec),
+				2 * sizeof (int64_t),
+				(off_t)(header->files_offset + i *
+					sizeof (cache_file_record) +
+					sizeof (uint64_t))) == (-1))) {
+			/* resetting the errno */
+			errno = 0;
+		}
+	}
+	if (update_fd != (-1)) {
+		close(update_fd);
+	}
+	close(fd);
+	if (retval != 0) {
+		munmap(mapping, mapping_size);
+		return (retval);
+	}
+	madvise(mapping, mapping_size, MADV_WILLNEED);
+	dist.adopt_mapping(mapping, mapping_size,
+			(const uint64_t *)(mapping + header->cumulative_offset),
+			(const uint32_t *)(mapping + header->symbols_offset),
+			(size_t)(header->symbol_count));
+	return (0);
+}
+
+/**
+ * A function which stores the distribution built
+ * from the corpus files into the cache file. The cache file
+ * is written under a temporary name first and then renamed,
+ * so that a concurrently running process never maps
+ * an incomplete cache file.
+ *
+ * @param
+ * cache_directory	the directory containing the cache files,
+ * 			it is created if it does not exist
+ * @param
+ * cache_path	the path of the cache file
+ * @param
+ * files	the corpus files
+ * @param
+ * input_encoding	the character encoding of the corpus files
+ * @param
+ * thread_count	the maximum number of threads used to compute
+ * 		the content hashes
+ * @param
+ * dist		the distribution built from the corpus files
+ *
+ * @return	If the cache file has been successfully written,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int store_distribution_cache (const char *cache_directory,
+		const std::string &cache_path,
+		const corpus_file_list &files,
+		const char *input_encoding,
+		size_t thread_count,
+		const distribution &dist) {
+	std::vector<std::string> paths;
+	std::vector<cache_file_record> records;
+	std::vector<char> buffer;
+	std::vector<char> temporary_path(cache_path.begin(), cache_path.end());
+	std::string strings = input_encoding;
+	cache_header header;
+	size_t i = 0;
+	size_t written = 0;
+	ssize_t write_retval = 0;
+	int fd = 0;
+	if (identify_corpus_files(files, paths, records) != 0) {
+		return (1);
+	}
+	for (i = 0; i < records.size(); ++i) {
+		if (hash_corpus_file(paths[i], (size_t)(records[i].size),
+				thread_count,
+				&(records[i].content_hash)) != 0) {
+			return (1);
+		}
+		records[i].path_offset = (uint64_t)(strings.size());
+		records[i].path_length = (uint64_t)(paths[i].size());
+		strings += paths[i];
+	}
+	memset(&header, 0, sizeof (header));
+	memcpy(header.magic, cache_magic, sizeof (cache_magic));
+	header.version = cache_version;
+	header.byte_order = cache_byte_order;
+	header.file_count = (uint64_t)(records.size());
+	header.symbol_count = (uint64_t)(dist.size());
+	header.total = dist.total();
+	header.encoding_length = (uint64_t)(strlen(input_encoding));
+	header.files_offset = (uint64_t)(sizeof (cache_header));
+	header.cumulative_offset = (header.files_offset + header.file_count *
+			sizeof (cache_file_record) + 7) / 8 * 8;
+	header.symbols_offset = header.cumulative_offset +
+		header.symbol_count * sizeof (uint64_t);
+	header.strings_offset = header.symbols_offset +
+		header.symbol_count * sizeof (uint32_t);
+	header.strings_size = (uint64_t)(strings.size());
+	header.cache_size = header.strings_offset + header.strings_size;
+	try {
+		buffer.resize((size_t)(header.cache_size), '\0');
+	} catch (std::bad_alloc &) {
+		std::cerr << "store_distribution_cache: allocation error!\n";
+		return (1);
+	}
+	memcpy(&(buffer[0]), &header, sizeof (header));
+	if (!records.empty()) {
+		memcpy(&(buffer[(size_t)(header.files_offset)]),
+				&(records[0]), records.size() *
+				sizeof (cache_file_record));
+	}
+	memcpy(&(buffer[(size_t)(header.cumulative_offset)]),
+			dist.cumulative(), dist.size() * sizeof (uint64_t));
+	memcpy(&(buffer[(size_t)(header.symbols_offset)]),
+			dist.symbols(), dist.size() * sizeof (uint32_t));
+	memcpy(&(buffer[(size_t)(header.strings_offset)]),
+			strings.data(), strings.size());
+	if ((mkdir(cache_directory, 0777) == (-1)) && (errno != EEXIST)) {
+		perror(cache_directory);
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	/* resetting the errno */
+	errno = 0;
+	temporary_path.insert(temporary_path.end(),
+			".XXXXXX", ".XXXXXX" + 8);
+	if ((fd = mkstemp(&(temporary_path[0]))) == (-1)) {
+		perror("store_distribution_cache: mkstemp");
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	while (written < buffer.size()) {
+		write_retval = write(fd, &(buffer[written]),
+				buffer.size() - written);
+		if (write_retval == (-1)) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		written += (size_t)(write_retval);
+	}
+	if ((close(fd) == (-1)) || (written < buffer.size()) ||
+			(rename(&(temporary_path[0]),
+				cache_path.c_str()) == (-1))) {
+		perror("store_distribution_cache: write");
+		/* resetting the errno */
+		errno = 0;
+		unlink(&(temporary_path[0]));
+		return (1);
+	}
+	return (0);
+}
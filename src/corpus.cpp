@@ -0,0 +1,481 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator corpus file functions.
+ * This file contains the implementation of functions,
+ * which are used to expand the input file arguments
+ * into the list of corpus files and to ingest several
+ * corpus files concurrently.
+ */
+
+#include "corpus.h"
+#include "ingest.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <iostream>
+#include <set>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utility>
+
+/* simple typedefs */
+
+/* the identities (device, inode) of the directories already visited */
+typedef std::set<std::pair<dev_t, ino_t> > directory_set;
+
+/* auxiliary structures */
+
+/* the state shared by all the tasks ingesting the corpus files */
+struct corpus_context {
+	const corpus_file_list *files;
+	/* the indices of the files in the order of their ingestion */
+	const size_t *order;
+	const char *input_encoding;
+	const char *internal_character_encoding;
+	/* the number of threads decoding a single file */
+	size_t file_thread_count;
+	/* the per-reader histograms */
+	character_histogram **histograms;
+	/* the per-reader numbers of decoded characters */
+	size_t *characters;
+};
+
+/*
+ * A comparator, which orders the indices of the corpus files
+ * by the decreasing size of the files they refer to.
+ */
+struct corpus_file_size_greater {
+	const corpus_file_list *files;
+	bool operator() (size_t a, size_t b) const {
+		return ((*files)[a].size > (*files)[b].size);
+	}
+};
+
+/* static functions */
+
+static int add_corpus_path (const std::string &path,
+		int top_level,
+		corpus_file_list &files,
+		directory_set &visited);
+
+/**
+ * A function which adds all the regular files contained
+ * in the specified directory and its subdirectories
+ * to the list of corpus files. The entries of each directory
+ * are added in the alphabetical order. Every directory is visited
+ * at most once, so the symbolic links can not cause a loop.
+ *
+ * @param
+ * path		the path of the directory
+ * @param
+ * directory_stat	the stat of the directory
+ * @param
+ * files	the list of corpus files
+ * @param
+ * visited	the set of already visited directories
+ *
+ * @return	If the directory has been successfully traversed,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int add_corpus_directory (const std::string &path,
+		const struct stat &directory_stat,
+		corpus_file_list &files,
+		directory_set &visited) {
+	std::vector<std::string> names;
+	std::string prefix = path;
+	DIR *directory = NULL;
+	struct dirent *entry = NULL;
+	size_t i = 0;
+	if (!visited.insert(std::make_pair(directory_stat.st_dev,
+					directory_stat.st_ino)).second) {
+		return (0);
+	}
+	if ((directory = opendir(path.c_str())) == NULL) {
+		perror(path.c_str());
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	/* the readdir only sets the errno in case of an error */
+	errno = 0;
+	while ((entry = readdir(directory)) != NULL) {
+		if ((strcmp(entry->d_name, ".") != 0) &&
+				(strcmp(entry->d_name, "..") != 0)) {
+			names.push_back(entry->d_name);
+		}
+	}
+	if (errno != 0) {
+		perror(path.c_str());
+		/* resetting the errno */
+		errno = 0;
+		closedir(directory);
+		return (1);
+	}
+	closedir(directory);
+	std::sort(names.begin(), names.end());
+	if ((prefix.empty()) || (prefix[prefix.size() - 1] != '/')) {
+		prefix += '/';
+	}
+	for (i = 0; i < names.size(); ++i) {
+		if (add_corpus_path(prefix + names[i], 0,
+					files, visited) != 0) {
+			return (1);
+		}
+	}
+	return (0);
+}
+
+/**
+ * A function which adds the specified path to the list
+ * of corpus files. A directory is searched recursively.
+ * Any other kind of file, like a pipe, is only accepted
+ * if it has been specified directly and not found in a directory.
+ *
+ * @param
+ * path		the path to add
+ * @param
+ * top_level	nonzero if the path has been specified directly
+ * @param
+ * files	the list of corpus files
+ * @param
+ * visited	the set of already visited directories
+ *
+ * @return	If the path has been successfully added,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int add_corpus_path (const std::string &path,
+		int top_level,
+		corpus_file_list &files,
+		directory_set &visited) {
+	struct stat path_stat;
+	corpus_file file;
+	if (stat(path.c_str(), &path_stat) == (-1)) {
+		perror(path.c_str());
+		/* resetting the errno */
+		errno = 0;
+		/* a dangling link found in a directory is skipped */
+		return ((top_level != 0) ? 1 : 0);
+	}
+	if (S_ISDIR(path_stat.st_mode)) {
+		return (add_corpus_directory(path, path_stat,
+					files, visited));
+	}
+	if ((top_level != 0) || (S_ISREG(path_stat.st_mode))) {
+		file.path = path;
+		file.size = (S_ISREG(path_stat.st_mode)) ?
+			(size_t)(path_stat.st_size) : corpus_unknown_size;
+		files.push_back(file);
+	}
+	return (0);
+}
+
+/**
+ * A task which ingests a single corpus file
+ * into the histogram of the executing reader.
+ *
+ * @param
+ * context	a pointer to the corpus_context structure
+ * @param
+ * task_index	the position of the file in the ingestion order
+ * @param
+ * worker_index	the index of the reader executing this task
+ *
+ * @return	If the file has been successfully ingested,
+ * 		this function returns zero.
+ * 		Otherwise, a positive error number is returned.
+ */
+static int corpus_file_task (void *context,
+		size_t task_index,
+		size_t worker_index) {
+	corpus_context *cc = (corpus_context *)(context);
+	const corpus_file &file = (*(cc->files))[cc->order[task_index]];
+	int fd = 0;
+	int retval = 0;
+	if ((fd = open_corpus_file(file)) == (-1)) {
+		return (1);
+	}
+	if ((retval = ingest_corpus_fd(fd, cc->input_encoding,
+				cc->internal_character_encoding,
+				cc->file_thread_count,
+				*(cc->histograms[worker_index]),
+				&(cc->characters[worker_index]),
+				NULL)) != 0) {
+		std::cerr << "Could not ingest the input file '" <<
+			file.path << "'!\n";
+	}
+	if (close_corpus_file(file, fd) != 0) {
+		retval = 1;
+	}
+	return (retval);
+}
+
+/* regular functions */
+
+/**
+ * A function which opens the corpus file for reading.
+ *
+ * @param
+ * file		the corpus file
+ *
+ * @return	This function returns the file descriptor
+ * 		of the corpus file, which is the standard input
+ * 		for the path "-", or (-1) in case of an error.
+ */
+int open_corpus_file (const corpus_file &file) {
+	int fd = 0;
+	if (file.path == corpus_standard_input) {
+		return (STDIN_FILENO);
+	}
+	if ((fd = open(file.path.c_str(), O_RDONLY)) == (-1)) {
+		perror(file.path.c_str());
+		/* resetting the errno */
+		errno = 0;
+	}
+	return (fd);
+}
+
+/**
+ * A function which closes the corpus file opened
+ * by the open_corpus_file function. The standard input
+ * is left open.
+ *
+ * @param
+ * file		the corpus file
+ * @param
+ * fd		the file descriptor of the corpus file
+ *
+ * @return	If the corpus file has been successfully closed,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int close_corpus_file (const corpus_file &file, int fd) {
+	if (file.path == corpus_standard_input) {
+		return (0);
+	}
+	if (close(fd) == (-1)) {
+		perror(file.path.c_str());
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	return (0);
+}
+
+/**
+ * A function which expands the input file arguments
+ * into the list of corpus files. An argument containing
+ * any of the characters '*', '?' or '[' is a glob pattern,
+ * which is expanded to the list of matching paths.
+ * A directory is replaced by all the regular files it contains,
+ * including those in its subdirectories. The argument "-"
+ * stands for the standard input.
+ *
+ * @param
+ * arguments	the input file arguments
+ * @param
+ * files	the corpus files will be appended to this list
+ *
+ * @return	If all the arguments have been successfully expanded
+ * 		and at least a single corpus file has been found,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int expand_corpus_paths (const std::vector<const char *> &arguments,
+		corpus_file_list &files) {
+	directory_set visited;
+	glob_t matches;
+	size_t i = 0;
+	size_t j = 0;
+	int glob_retval = 0;
+	corpus_file standard_input;
+	struct stat standard_input_stat;
+	int standard_input_added = 0;
+	for (i = 0; i < arguments.size(); ++i) {
+		if (strcmp(arguments[i], corpus_standard_input) == 0) {
+			if (standard_input_added != 0) {
+				std::cerr << "The standard input can only "
+					"be read once!\n";
+				return (1);
+			}
+			standard_input.path = corpus_standard_input;
+			standard_input.size = corpus_unknown_size;
+			if ((fstat(STDIN_FILENO, &standard_input_stat) == 0) &&
+					(S_ISREG(standard_input_stat.st_mode))) {
+				standard_input.size = (size_t)
+					(standard_input_stat.st_size);
+			}
+			/* resetting the errno */
+			errno = 0;
+			files.push_back(standard_input);
+			standard_input_added = 1;
+			continue;
+		}
+		if (strpbrk(arguments[i], "*?[") == NULL) {
+			if (add_corpus_path(arguments[i], 1,
+						files, visited) != 0) {
+				return (1);
+			}
+			continue;
+		}
+		if ((glob_retval = glob(arguments[i], 0,
+					NULL, &matches)) != 0) {
+			if (glob_retval == GLOB_NOMATCH) {
+				std::cerr << "No input file matches "
+					"the pattern '" <<
+					arguments[i] << "'!\n";
+			} else {
+				std::cerr << "Could not expand "
+					"the pattern '" <<
+					arguments[i] << "'!\n";
+			}
+			globfree(&matches);
+			/* resetting the errno */
+			errno = 0;
+			return (1);
+		}
+		for (j = 0; j < matches.gl_pathc; ++j) {
+			if (add_corpus_path(matches.gl_pathv[j], 1,
+						files, visited) != 0) {
+				globfree(&matches);
+				return (1);
+			}
+		}
+		globfree(&matches);
+	}
+	if (files.empty()) {
+		std::cerr << "No input files have been found!\n";
+		return (1);
+	}
+	return (0);
+}
+
+/**
+ * A function which reads all the corpus files,
+ * decodes their characters and counts their occurrences.
+ * The files are ingested concurrently by a pool of readers,
+ * each of them counting into its own histogram, and the per-reader
+ * histograms are merged into the provided histogram at the end.
+ * The largest files are handed out first, so that the readers
+ * finish at about the same time. The pipes, whose size is not known,
+ * are handed out before all the other files. The threads not needed
+ * as readers are used to decode the chunks of the individual files,
+ * so a single large file still uses all of them.
+ *
+ * @param
+ * files	the corpus files
+ * @param
+ * input_encoding	the character encoding of the corpus files
+ * @param
+ * internal_character_encoding	the encoding of the wchar_t characters
+ * @param
+ * thread_count	the maximum number of threads to use
+ * @param
+ * histogram	the histogram to which the character occurrences
+ * 		will be added
+ * @param
+ * total_characters	the number of the decoded characters
+ * 			will be added to this variable
+ *
+ * @return	If all the corpus files have been successfully read
+ * 		and decoded, this function returns zero.
+ * 		Otherwise, in case of any error,
+ * 		a positive error number is returned.
+ */
+int ingest_corpus_files (const corpus_file_list &files,
+		const char *input_encoding,
+		const char *internal_character_encoding,
+		size_t thread_count,
+		character_histogram &histogram,
+		size_t *total_characters) {
+	corpus_context cc;
+	corpus_file_size_greater greater;
+	size_t *order = NULL;
+	size_t reader_count = 0;
+	size_t i = 0;
+	int retval = 0;
+	if (thread_count < 1) {
+		thread_count = 1;
+	}
+	reader_count = std::min(thread_count, files.size());
+	cc.files = &files;
+	cc.input_encoding = input_encoding;
+	cc.internal_character_encoding = internal_character_encoding;
+	cc.file_thread_count = thread_count / reader_count;
+	cc.histograms = NULL;
+	cc.characters = NULL;
+	try {
+		order = new size_t[files.size()];
+		cc.characters = new size_t[reader_count];
+		cc.histograms = new character_histogram *[reader_count];
+		for (i = 0; i < reader_count; ++i) {
+			cc.histograms[i] = NULL;
+			cc.characters[i] = 0;
+		}
+		for (i = 1; i < reader_count; ++i) {
+			cc.histograms[i] = new character_histogram();
+		}
+		/* the reader zero counts directly into the result */
+		cc.histograms[0] = &histogram;
+	} catch (std::bad_alloc &) {
+		std::cerr << "reader histogram allocation error!\n";
+		retval = 1;
+	}
+	if (retval == 0) {
+		for (i = 0; i < files.size(); ++i) {
+			order[i] = i;
+		}
+		greater.files = &files;
+		std::stable_sort(order, order + files.size(), greater);
+		cc.order = order;
+		retval = run_parallel(corpus_file_task, &cc,
+				files.size(), reader_count);
+		if (retval < 0) {
+			retval = 1;
+		}
+	}
+	if (cc.histograms != NULL) {
+		for (i = 1; i < reader_count; ++i) {
+			if (cc.histograms[i] != NULL) {
+				histogram.merge(*(cc.histograms[i]));
+				delete cc.histograms[i];
+			}
+		}
+	}
+	if ((retval == 0) && (cc.characters != NULL)) {
+		for (i = 0; i < reader_count; ++i) {
+			(*total_characters) += cc.characters[i];
+		}
+	}
+	delete[] cc.histograms;
+	delete[] cc.characters;
+	delete[] order;
+	return (retval);
+}
@@ -0,0 +1,631 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator built-in decoders.
+ * This file contains the implementation of functions,
+ * which are used to decode the most common Unicode encodings
+ * and the ISO-8859-1 directly into a character histogram,
+ * without calling the iconv.
+ *
+ * The decoders validate their input in the same way as the iconv does,
+ * so an invalid input is rejected rather than silently counted.
+ * If the SSE2 instruction set is available, the runs of the ASCII
+ * characters and the blocks of the characters, which do not need
+ * any special handling, are validated sixteen bytes at a time.
+ */
+
+#include "decoder.h"
+
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+/*
+ * the vectorized code paths store the decoded characters
+ * as 32-bit integers, so they require the four-byte wchar_t
+ */
+#if defined(__SSE2__) && defined(__SIZEOF_WCHAR_T__) && \
+	(__SIZEOF_WCHAR_T__ == 4)
+#define DECODER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/* constants */
+
+/* the number of wide characters collected before counting them */
+static const size_t decoder_batch_size = 256;
+
+/* auxiliary classes */
+
+/*
+ * A small buffer of decoded wide characters,
+ * which are counted in the histogram in batches.
+ */
+class decoded_batch {
+public:
+	decoded_batch (character_histogram &histogram_arg) :
+			total(0), histogram(histogram_arg), count(0) {
+	}
+	void push (unsigned long code_point) {
+		if (count == decoder_batch_size) {
+			flush();
+		}
+		wbuffer[count++] = (wchar_t)(code_point);
+	}
+	wchar_t *reserve (size_t size) {
+		if (count + size > decoder_batch_size) {
+			flush();
+		}
+		return (wbuffer + count);
+	}
+	void commit (size_t size) {
+		count += size;
+	}
+	void flush () {
+		histogram.add(wbuffer, count);
+		total += count;
+		count = 0;
+	}
+	/* the number of characters counted so far */
+	size_t total;
+private:
+	character_histogram &histogram;
+	wchar_t wbuffer[decoder_batch_size];
+	size_t count;
+};
+
+/* static functions */
+
+#ifdef DECODER_SSE2
+/**
+ * A function which swaps the bytes in each of the 16-bit units.
+ */
+static inline __m128i swap_bytes_16 (__m128i v) {
+	return (_mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+}
+
+/**
+ * A function which swaps the bytes in each of the 32-bit units.
+ */
+static inline __m128i swap_bytes_32 (__m128i v) {
+	v = swap_bytes_16(v);
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	return (_mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+#endif
+
+/**
+ * A function which decodes a single UTF-8 sequence
+ * starting with a non-ASCII byte.
+ *
+ * @param
+ * bytes	the beginning of the sequence
+ * @param
+ * size		the number of bytes available
+ * @param
+ * code_point	when this function returns zero, this variable
+ * 		will be set to the decoded code point
+ * @param
+ * length	when this function returns zero, this variable
+ * 		will be set to the length of the sequence
+ *
+ * @return	If the sequence is valid, this function returns zero.
+ * 		If the sequence is incomplete, this function returns (-1).
+ * 		If the sequence is invalid, this function returns (1).
+ */
+static int decode_utf8_sequence (const unsigned char *bytes,
+		size_t size,
+		unsigned long *code_point,
+		size_t *length) {
+	unsigned long c = bytes[0];
+	size_t needed = 0;
+	size_t i = 0;
+	if (c < 0xC2) {
+		/* a continuation byte or an overlong two-byte sequence */
+		return (1);
+	} else if (c < 0xE0) {
+		needed = 1;
+		c &= 0x1F;
+	} else if (c < 0xF0) {
+		needed = 2;
+		c &= 0x0F;
+	} else if (c < 0xF5) {
+		needed = 3;
+		c &= 0x07;
+	} else {
+		return (1);
+	}
+	for (i = 1; i <= needed; ++i) {
+		if (i >= size) {
+			return (-1);
+		}
+		if ((bytes[i] & 0xC0) != 0x80) {
+			return (1);
+		}
+		c = (c << 6) | (unsigned long)(bytes[i] & 0x3F);
+	}
+	/* rejecting the overlong forms and the surrogates */
+	if ((needed == 2) && ((c < 0x800) ||
+				((c >= 0xD800) && (c <= 0xDFFF)))) {
+		return (1);
+	}
+	if ((needed == 3) && ((c < 0x10000) || (c > 0x10FFFF))) {
+		return (1);
+	}
+	(*code_point) = c;
+	(*length) = needed + 1;
+	return (0);
+}
+
+/**
+ * A function which decodes the UTF-8 input.
+ * The runs of the ASCII characters are counted directly as bytes.
+ *
+ * @return	This function returns the same values
+ * 		as the decode_builtin function.
+ */
+static int decode_utf8 (const unsigned char *bytes,
+		size_t size,
+		character_histogram &histogram,
+		size_t *unused_input_bytes,
+		size_t *characters) {
+	decoded_batch batch(histogram);
+	unsigned long code_point = 0;
+	size_t length = 0;
+	size_t ascii_characters = 0;
+	size_t run_start = 0;
+	size_t i = 0;
+	int retval = 0;
+#ifdef DECODER_SSE2
+	int mask = 0;
+#endif
+	while ((i < size) && (retval == 0)) {
+		run_start = i;
+#ifdef DECODER_SSE2
+		while (i + 16 <= size) {
+			mask = _mm_movemask_epi8(_mm_loadu_si128(
+					(const __m128i *)(bytes + i)));
+			if (mask != 0) {
+				i += (size_t)(__builtin_ctz((unsigned int)(mask)));
+				break;
+			}
+			i += 16;
+		}
+#endif
+		while ((i < size) && (bytes[i] < 0x80)) {
+			++i;
+		}
+		if (i > run_start) {
+			histogram.add_bytes(bytes + run_start, i - run_start);
+			ascii_characters += i - run_start;
+		}
+		while ((i < size) && (bytes[i] >= 0x80)) {
+			retval = decode_utf8_sequence(bytes + i, size - i,
+					&code_point, &length);
+			if (retval != 0) {
+				break;
+			}
+			batch.push(code_point);
+			i += length;
+		}
+	}
+	batch.flush();
+	(*characters) += ascii_characters + batch.total;
+	if (retval < 0) {
+		(*unused_input_bytes) = size - i;
+		return (-1);
+	} else if (retval > 0) {
+		std::cerr << "decode_builtin: invalid UTF-8 sequence!\n";
+		return (1);
+	}
+	return (0);
+}
+
+/**
+ * A function which decodes the UTF-16 or the UCS-2 input.
+ *
+ * @param
+ * big_endian	nonzero for the big endian byte order
+ * @param
+ * surrogates	nonzero if the surrogate pairs are allowed (UTF-16)
+ *
+ * @return	This function returns the same values
+ * 		as the decode_builtin function.
+ */
+static int decode_utf16 (const unsigned char *bytes,
+		size_t size,
+		int big_endian,
+		int surrogates,
+		character_histogram &histogram,
+		size_t *unused_input_bytes,
+		size_t *characters) {
+	decoded_batch batch(histogram);
+	unsigned long unit = 0;
+	unsigned long next = 0;
+	size_t i = 0;
+	int retval = 0;
+#ifdef DECODER_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i surrogate_mask = _mm_set1_epi16((short)(0xF800));
+	const __m128i surrogate_value = _mm_set1_epi16((short)(0xD800));
+	__m128i v;
+	wchar_t *out = NULL;
+#endif
+	while (i + 2 <= size) {
+#ifdef DECODER_SSE2
+		/* eight characters without any surrogates at a time */
+		while (i + 16 <= size) {
+			v = _mm_loadu_si128((const __m128i *)(bytes + i));
+			if (big_endian != 0) {
+				v = swap_bytes_16(v);
+			}
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(
+						_mm_and_si128(v,
+							surrogate_mask),
+						surrogate_value)) != 0) {
+				break;
+			}
+			out = batch.reserve(8);
+			_mm_storeu_si128((__m128i *)(out),
+					_mm_unpacklo_epi16(v, zero));
+			_mm_storeu_si128((__m128i *)(out + 4),
+					_mm_unpackhi_epi16(v, zero));
+			batch.commit(8);
+			i += 16;
+		}
+		if (i + 2 > size) {
+			break;
+		}
+#endif
+		if (big_endian != 0) {
+			unit = ((unsigned long)(bytes[i]) << 8) | bytes[i + 1];
+		} else {
+			unit = ((unsigned long)(bytes[i + 1]) << 8) | bytes[i];
+		}
+		if ((unit & 0xF800) != 0xD800) {
+			batch.push(unit);
+			i += 2;
+			continue;
+		}
+		/* a low surrogate without a high one, or UCS-2 */
+		if ((surrogates == 0) || (unit >= 0xDC00)) {
+			retval = 1;
+			break;
+		}
+		if (i + 4 > size) {
+			retval = (-1);
+			break;
+		}
+		if (big_endian != 0) {
+			next = ((unsigned long)(bytes[i + 2]) << 8) |
+				bytes[i + 3];
+		} else {
+			next = ((unsigned long)(bytes[i + 3]) << 8) |
+				bytes[i + 2];
+		}
+		if ((next & 0xFC00) != 0xDC00) {
+			retval = 1;
+			break;
+		}
+		batch.push(0x10000 + ((unit - 0xD800) << 10) +
+				(next - 0xDC00));
+		i += 4;
+	}
+	batch.flush();
+	(*characters) += batch.total;
+	if ((retval == 0) && (i < size)) {
+		/* an odd byte at the end */
+		retval = (-1);
+	}
+	if (retval < 0) {
+		(*unused_input_bytes) = size - i;
+		return (-1);
+	} else if (retval > 0) {
+		std::cerr << "decode_builtin: invalid UTF-16 "
+			"or UCS-2 character!\n";
+		return (1);
+	}
+	return (0);
+}
+
+/**
+ * A function which decodes the UCS-4 or the UTF-32 input.
+ *
+ * @param
+ * big_endian	nonzero for the big endian byte order
+ * @param
+ * strict	nonzero if only the Unicode scalar values
+ * 		are allowed (UTF-32), zero if all the 31-bit
+ * 		values are allowed (UCS-4)
+ *
+ * @return	This function returns the same values
+ * 		as the decode_builtin function.
+ */
+static int decode_ucs4 (const unsigned char *bytes,
+		size_t size,
+		int big_endian,
+		int strict,
+		character_histogram &histogram,
+		size_t *unused_input_bytes,
+		size_t *characters) {
+	decoded_batch batch(histogram);
+	unsigned long c = 0;
+	size_t i = 0;
+	int retval = 0;
+#ifdef DECODER_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i plane_limit = _mm_set1_epi32(0x10);
+	const __m128i surrogate_mask = _mm_set1_epi32((int)(0xFFFFF800));
+	const __m128i surrogate_value = _mm_set1_epi32(0xD800);
+	__m128i v;
+	__m128i invalid;
+	wchar_t *out = NULL;
+#endif
+	while (i + 4 <= size) {
+#ifdef DECODER_SSE2
+		/* four characters at a time */
+		while (i + 16 <= size) {
+			v = _mm_loadu_si128((const __m128i *)(bytes + i));
+			if (big_endian != 0) {
+				v = swap_bytes_32(v);
+			}
+			if (strict != 0) {
+				invalid = _mm_or_si128(
+						_mm_cmpgt_epi32(
+							_mm_srli_epi32(v, 16),
+							plane_limit),
+						_mm_cmpeq_epi32(
+							_mm_and_si128(v,
+							surrogate_mask),
+							surrogate_value));
+			} else {
+				invalid = _mm_cmplt_epi32(v, zero);
+			}
+			if (_mm_movemask_epi8(invalid) != 0) {
+				break;
+			}
+			out = batch.reserve(4);
+			_mm_storeu_si128((__m128i *)(out), v);
+			batch.commit(4);
+			i += 16;
+		}
+		if (i + 4 > size) {
+			break;
+		}
+#endif
+		if (big_endian != 0) {
+			c = ((unsigned long)(bytes[i]) << 24) |
+				((unsigned long)(bytes[i + 1]) << 16) |
+				((unsigned long)(bytes[i + 2]) << 8) |
+				bytes[i + 3];
+		} else {
+			c = ((unsigned long)(bytes[i + 3]) << 24) |
+				((unsigned long)(bytes[i + 2]) << 16) |
+				((unsigned long)(bytes[i + 1]) << 8) |
+				bytes[i];
+		}
+		if ((strict != 0) ? ((c > 0x10FFFF) ||
+					((c >= 0xD800) && (c <= 0xDFFF))) :
+				(c > 0x7FFFFFFF)) {
+			retval = 1;
+			break;
+		}
+		batch.push(c);
+		i += 4;
+	}
+	batch.flush();
+	(*characters) += batch.total;
+	if ((retval == 0) && (i < size)) {
+		retval = (-1);
+	}
+	if (retval < 0) {
+		(*unused_input_bytes) = size - i;
+		return (-1);
+	} else if (retval > 0) {
+		std::cerr << "decode_builtin: invalid UCS-4 "
+			"or UTF-32 character!\n";
+		return (1);
+	}
+	return (0);
+}
+
+/**
+ * A function which validates and counts the ASCII input.
+ *
+ * @return	This function returns the same values
+ * 		as the decode_builtin function.
+ */
+static int decode_ascii (const unsigned char *bytes,
+		size_t size,
+		character_histogram &histogram,
+		size_t *characters) {
+	size_t i = 0;
+#ifdef DECODER_SSE2
+	__m128i high_bits = _mm_setzero_si128();
+	for (; i + 16 <= size; i += 16) {
+		high_bits = _mm_or_si128(high_bits, _mm_loadu_si128(
+					(const __m128i *)(bytes + i)));
+	}
+	if (_mm_movemask_epi8(high_bits) != 0) {
+		i = 0;
+	}
+#endif
+	for (; i < size; ++i) {
+		if (bytes[i] >= 0x80) {
+			std::cerr << "decode_builtin: "
+				"invalid ASCII character!\n";
+			return (1);
+		}
+	}
+	histogram.add_bytes(bytes, size);
+	(*characters) += size;
+	return (0);
+}
+
+/* regular functions */
+
+/**
+ * A function which normalizes the provided character encoding name
+ * for comparisons. It converts the name to upper case and removes
+ * the dashes, the underscores and any iconv suffixes
+ * like "//TRANSLIT".
+ *
+ * @param
+ * encoding	the name of the character encoding
+ *
+ * @return	This function returns the normalized name.
+ */
+std::string normalize_encoding_name (const char *encoding) {
+	std::string name;
+	for (; ((*encoding) != '\0') && ((*encoding) != '/'); ++encoding) {
+		if (((*encoding) != '-') && ((*encoding) != '_')) {
+			name += (char)(toupper((unsigned char)(*encoding)));
+		}
+	}
+	return (name);
+}
+
+/**
+ * A function which selects the built-in decoder
+ * for the provided character encoding.
+ *
+ * @param
+ * encoding	the name of the character encoding
+ *
+ * @return	This function returns one of the builtin_decoder values.
+ * 		If the wchar_t can not hold all the Unicode characters,
+ * 		or if the encoding name contains an iconv suffix,
+ * 		like "//IGNORE", BUILTIN_DECODER_NONE is returned.
+ */
+int select_builtin_decoder (const char *encoding) {
+	std::string name;
+	if ((sizeof (wchar_t) < 4) || (strchr(encoding, '/') != NULL)) {
+		return (BUILTIN_DECODER_NONE);
+	}
+	name = normalize_encoding_name(encoding);
+	if (name == "UTF8") {
+		return (BUILTIN_DECODER_UTF8);
+	} else if (name == "UTF16LE") {
+		return (BUILTIN_DECODER_UTF16LE);
+	} else if (name == "UTF16BE") {
+		return (BUILTIN_DECODER_UTF16BE);
+	} else if (name == "UCS2LE") {
+		return (BUILTIN_DECODER_UCS2LE);
+	} else if (name == "UCS2BE") {
+		return (BUILTIN_DECODER_UCS2BE);
+	} else if (name == "UCS4LE") {
+		return (BUILTIN_DECODER_UCS4LE);
+	} else if (name == "UCS4BE") {
+		return (BUILTIN_DECODER_UCS4BE);
+	} else if (name == "UTF32LE") {
+		return (BUILTIN_DECODER_UTF32LE);
+	} else if (name == "UTF32BE") {
+		return (BUILTIN_DECODER_UTF32BE);
+	} else if ((name == "ISO88591") || (name == "ISO88591:1987") ||
+			(name == "LATIN1") || (name == "L1") ||
+			(name == "ISOIR100") || (name == "CP819") ||
+			(name == "IBM819")) {
+		return (BUILTIN_DECODER_LATIN1);
+	} else if ((name == "ASCII") || (name == "USASCII") ||
+			(name == "ANSIX3.41968")) {
+		return (BUILTIN_DECODER_ASCII);
+	}
+	return (BUILTIN_DECODER_NONE);
+}
+
+/**
+ * A function which decodes the provided buffer of encoded characters
+ * using the specified built-in decoder and counts the occurrences
+ * of the decoded characters in the provided histogram.
+ *
+ * @param
+ * decoder	one of the builtin_decoder values
+ * @param
+ * input_buffer	the buffer of encoded characters
+ * @param
+ * input_buffer_size	the number of bytes in the input buffer
+ * @param
+ * histogram	the histogram of character occurrences
+ * @param
+ * unused_input_bytes	when this function returns, this variable
+ * 			will be set to the number of bytes
+ * 			of the incomplete character at the end
+ * 			of the input buffer
+ * @param
+ * characters	the number of decoded characters
+ * 		will be added to this variable
+ *
+ * @return	If the entire input buffer has been successfully decoded,
+ * 		this function returns zero.
+ * 		If there was an incomplete multi-byte sequence
+ * 		at the end of the input buffer, this function returns (-1).
+ * 		Otherwise, in case of any error,
+ * 		a positive error number is returned.
+ */
+int decode_builtin (int decoder,
+		const char *input_buffer,
+		size_t input_buffer_size,
+		character_histogram &histogram,
+		size_t *unused_input_bytes,
+		size_t *characters) {
+	const unsigned char *bytes = (const unsigned char *)(input_buffer);
+	(*unused_input_bytes) = 0;
+	switch (decoder) {
+		case BUILTIN_DECODER_UTF8:
+			return (decode_utf8(bytes, input_buffer_size,
+					histogram, unused_input_bytes,
+					characters));
+		case BUILTIN_DECODER_UTF16LE:
+		case BUILTIN_DECODER_UTF16BE:
+		case BUILTIN_DECODER_UCS2LE:
+		case BUILTIN_DECODER_UCS2BE:
+			return (decode_utf16(bytes, input_buffer_size,
+					(decoder == BUILTIN_DECODER_UTF16BE) ||
+					(decoder == BUILTIN_DECODER_UCS2BE),
+					(decoder == BUILTIN_DECODER_UTF16LE) ||
+					(decoder == BUILTIN_DECODER_UTF16BE),
+					histogram, unused_input_bytes,
+					characters));
+		case BUILTIN_DECODER_UCS4LE:
+		case BUILTIN_DECODER_UCS4BE:
+		case BUILTIN_DECODER_UTF32LE:
+		case BUILTIN_DECODER_UTF32BE:
+			return (decode_ucs4(bytes, input_buffer_size,
+					(decoder == BUILTIN_DECODER_UCS4BE) ||
+					(decoder == BUILTIN_DECODER_UTF32BE),
+					(decoder == BUILTIN_DECODER_UTF32LE) ||
+					(decoder == BUILTIN_DECODER_UTF32BE),
+					histogram, unused_input_bytes,
+					characters));
+		case BUILTIN_DECODER_LATIN1:
+			histogram.add_bytes(bytes, input_buffer_size);
+			(*characters) += input_buffer_size;
+			return (0);
+		case BUILTIN_DECODER_ASCII:
+			return (decode_ascii(bytes, input_buffer_size,
+					histogram, characters));
+		default:
+			std::cerr << "Unknown built-in decoder (" <<
+				decoder << ")!\n";
+			return (1);
+	}
+}
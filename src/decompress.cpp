@@ -0,0 +1,495 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator corpus decompression.
+ * This file contains the implementation of the class,
+ * which decompresses a gzip- or xz-compressed input file
+ * on a separate thread.
+ */
+
+#include "decompress.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <lzma.h>
+#include <zlib.h>
+
+/* member functions */
+
+decompressor::decompressor () :
+		fd(-1),
+		format(COMPRESSION_NONE),
+		input(NULL),
+		pending(0),
+		head(0),
+		filled(0),
+		offset(0),
+		finished(0),
+		failed(0),
+		stopped(0),
+		started(0) {
+	for (size_t i = 0; i < buffer_count; ++i) {
+		buffers[i] = NULL;
+		sizes[i] = 0;
+	}
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&cond, NULL);
+}
+
+decompressor::~decompressor () {
+	finish();
+	for (size_t i = 0; i < buffer_count; ++i) {
+		delete[] buffers[i];
+	}
+	delete[] input;
+	pthread_cond_destroy(&cond);
+	pthread_mutex_destroy(&mutex);
+}
+
+/**
+ * A member function which starts the producer thread
+ * decompressing the input file. The first bytes of the input file
+ * may have already been read by the caller, like the magic bytes
+ * of a pipe, which can not be read twice.
+ *
+ * @param
+ * fd		the file descriptor of the compressed input file
+ * @param
+ * format	the compression format of the input file
+ * @param
+ * prefix	the bytes already read from the input file, or NULL
+ * @param
+ * prefix_size	the number of the bytes already read,
+ * 		at most 1 MiB
+ *
+ * @return	If the producer thread has been successfully started,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int decompressor::start (int fd,
+		int format,
+		const char *prefix,
+		size_t prefix_size) {
+	int pthread_retval = 0;
+	this->fd = fd;
+	this->format = format;
+	try {
+		for (size_t i = 0; i < buffer_count; ++i) {
+			buffers[i] = new char[buffer_size];
+		}
+		input = new char[input_size];
+	} catch (std::bad_alloc &) {
+		std::cerr << "decompressor: buffer allocation error!\n";
+		return (1);
+	}
+	if ((prefix != NULL) && (prefix_size > 0)) {
+		pending = (prefix_size > input_size) ? input_size : prefix_size;
+		memcpy(input, prefix, pending);
+	}
+	pthread_retval = pthread_create(&thread, NULL, producer_main, this);
+	if (pthread_retval != 0) {
+		std::cerr << "decompressor: pthread_create: " <<
+			strerror(pthread_retval) << "\n";
+		return (1);
+	}
+	started = 1;
+	return (0);
+}
+
+/**
+ * A member function which reads the next 'buffer_size' bytes
+ * of the decompressed data into the 'buffer'.
+ * It blocks until the buffer is full or there is no more data.
+ *
+ * @param
+ * buffer	the buffer for the decompressed data
+ * @param
+ * buffer_size	the size of the buffer
+ * @param
+ * bytes_read	this variable will be set to the number of bytes read
+ *
+ * @return	If the buffer has been filled, this function returns zero.
+ * 		If the end of the decompressed data has been reached,
+ * 		it returns (-1).
+ * 		Otherwise, in case of a decompression error,
+ * 		it returns one (1).
+ */
+int decompressor::read (char *buffer, size_t buffer_size, size_t *bytes_read) {
+	size_t chunk = 0;
+	int retval = 0;
+	(*bytes_read) = 0;
+	pthread_mutex_lock(&mutex);
+	while ((*bytes_read) < buffer_size) {
+		while ((filled == 0) && (finished == 0)) {
+			pthread_cond_wait(&cond, &mutex);
+		}
+		if (filled == 0) {
+			break;
+		}
+		chunk = sizes[head] - offset;
+		if (chunk > buffer_size - (*bytes_read)) {
+			chunk = buffer_size - (*bytes_read);
+		}
+		/* the filled buffer is not touched by the producer */
+		pthread_mutex_unlock(&mutex);
+		memcpy(buffer + (*bytes_read), buffers[head] + offset, chunk);
+		pthread_mutex_lock(&mutex);
+		offset += chunk;
+		(*bytes_read) += chunk;
+		if (offset == sizes[head]) {
+			offset = 0;
+			head = (head + 1) % buffer_count;
+			--filled;
+			pthread_cond_broadcast(&cond);
+		}
+	}
+	if ((*bytes_read) == buffer_size) {
+		retval = 0;
+	} else if (failed != 0) {
+		retval = 1;
+	} else {
+		retval = (-1);
+	}
+	pthread_mutex_unlock(&mutex);
+	return (retval);
+}
+
+/**
+ * A member function which stops the producer thread
+ * and waits for it to finish.
+ *
+ * @return	If the input file has been decompressed without errors
+ * 		so far, this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int decompressor::finish () {
+	int retval = 0;
+	if (started == 0) {
+		return (0);
+	}
+	pthread_mutex_lock(&mutex);
+	stopped = 1;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&mutex);
+	pthread_join(thread, NULL);
+	started = 0;
+	retval = (failed != 0) ? 1 : 0;
+	return (retval);
+}
+
+/**
+ * The function executed by the producer thread.
+ *
+ * @param
+ * argument	a pointer to the decompressor
+ *
+ * @return	This function always returns NULL.
+ */
+void *decompressor::producer_main (void *argument) {
+	decompressor *dc = (decompressor *)(argument);
+	int retval = dc->produce();
+	pthread_mutex_lock(&(dc->mutex));
+	dc->finished = 1;
+	dc->failed = (retval != 0);
+	pthread_cond_broadcast(&(dc->cond));
+	pthread_mutex_unlock(&(dc->mutex));
+	return (NULL);
+}
+
+/**
+ * A member function which decompresses the entire input file.
+ *
+ * @return	If the input file has been successfully decompressed,
+ * 		or if the consumer has stopped the producer,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int decompressor::produce () {
+	switch (format) {
+		case COMPRESSION_GZIP:
+			return (inflate_gzip());
+		case COMPRESSION_XZ:
+			return (inflate_xz());
+	}
+	return (1);
+}
+
+/**
+ * A member function which waits for an empty buffer in the ring.
+ *
+ * @return	This function returns the empty buffer,
+ * 		or NULL if the consumer has stopped the producer.
+ */
+char *decompressor::acquire_buffer () {
+	char *buffer = NULL;
+	pthread_mutex_lock(&mutex);
+	while ((filled == buffer_count) && (stopped == 0)) {
+		pthread_cond_wait(&cond, &mutex);
+	}
+	if (stopped == 0) {
+		buffer = buffers[(head + filled) % buffer_count];
+	}
+	pthread_mutex_unlock(&mutex);
+	return (buffer);
+}
+
+/**
+ * A member function which hands the last acquired buffer
+ * over to the consumer.
+ *
+ * @param
+ * size		the number of bytes of decompressed data in the buffer
+ */
+void decompressor::publish_buffer (size_t size) {
+	pthread_mutex_lock(&mutex);
+	sizes[(head + filled) % buffer_count] = size;
+	++filled;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * A member function which reads the next block
+ * of the compressed input file. The bytes read by the caller
+ * before the start are returned first.
+ *
+ * @param
+ * bytes_read	this variable will be set to the number of bytes read
+ *
+ * @return	This function returns the value returned
+ * 		by the text_file_read_buffer function,
+ * 		or zero for the bytes read before the start.
+ */
+int decompressor::read_input (size_t *bytes_read) {
+	int retval = 0;
+	if (pending > 0) {
+		(*bytes_read) = pending;
+		pending = 0;
+		return (0);
+	}
+	retval = text_file_read_buffer(fd, input, input_size, bytes_read);
+	if (retval > 0) {
+		std::cerr << "Could not read the compressed input file!\n";
+	}
+	return (retval);
+}
+
+/**
+ * A member function which decompresses the gzip-compressed
+ * input file. Several concatenated gzip members are decompressed
+ * as a single stream, like the gzip utility does.
+ *
+ * @return	If the input file has been successfully decompressed,
+ * 		or if the consumer has stopped the producer,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int decompressor::inflate_gzip () {
+	z_stream zs;
+	char *output = NULL;
+	size_t bytes_read = 0;
+	int input_end = 0;
+	/* nonzero if the last member has been completely decompressed */
+	int member_end = 0;
+	int read_retval = 0;
+	int z_retval = Z_OK;
+	int retval = 0;
+	memset(&zs, 0, sizeof (zs));
+	/* the window size 15 plus 32 enables the gzip header detection */
+	if (inflateInit2(&zs, 15 + 32) != Z_OK) {
+		std::cerr << "inflateInit2: " <<
+			((zs.msg != NULL) ? zs.msg : "error") << "\n";
+		return (1);
+	}
+	if ((output = acquire_buffer()) == NULL) {
+		inflateEnd(&zs);
+		return (0);
+	}
+	zs.next_out = (Bytef *)(output);
+	zs.avail_out = (uInt)(buffer_size);
+	for (;;) {
+		if ((zs.avail_in == 0) && (input_end == 0)) {
+			if ((read_retval = read_input(&bytes_read)) > 0) {
+				retval = 1;
+				break;
+			}
+			input_end = (read_retval != 0);
+			zs.next_in = (Bytef *)(input);
+			zs.avail_in = (uInt)(bytes_read);
+		}
+		if (zs.avail_in > 0) {
+			member_end = 0;
+		}
+		z_retval = inflate(&zs, Z_NO_FLUSH);
+		if (z_retval == Z_STREAM_END) {
+			member_end = 1;
+			inflateReset(&zs);
+		} else if (z_retval == Z_BUF_ERROR) {
+			/* no progress is possible without more input */
+			if ((zs.avail_in == 0) && (input_end != 0) &&
+					(zs.avail_out != 0)) {
+				if (member_end == 0) {
+					std::cerr << "Error: The gzip-"
+						"compressed input file "
+						"is truncated!\n";
+					retval = 1;
+				}
+				break;
+			}
+		} else if (z_retval != Z_OK) {
+			std::cerr << "Error: The gzip-compressed input file "
+				"is corrupted: " << ((zs.msg != NULL) ?
+						zs.msg : "inflate error") << "\n";
+			retval = 1;
+			break;
+		}
+		if (zs.avail_out == 0) {
+			publish_buffer(buffer_size);
+			if ((output = acquire_buffer()) == NULL) {
+				break;
+			}
+			zs.next_out = (Bytef *)(output);
+			zs.avail_out = (uInt)(buffer_size);
+		}
+	}
+	if ((output != NULL) && (zs.avail_out < buffer_size)) {
+		publish_buffer(buffer_size - zs.avail_out);
+	}
+	inflateEnd(&zs);
+	return (retval);
+}
+
+/**
+ * A member function which decompresses the xz-compressed input file.
+ * Several concatenated xz streams are decompressed
+ * as a single stream, like the xz utility does.
+ *
+ * @return	If the input file has been successfully decompressed,
+ * 		or if the consumer has stopped the producer,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int decompressor::inflate_xz () {
+	lzma_stream ls;
+	lzma_action action = LZMA_RUN;
+	lzma_ret lzma_retval = LZMA_OK;
+	char *output = NULL;
+	size_t bytes_read = 0;
+	int input_end = 0;
+	int read_retval = 0;
+	int retval = 0;
+	/* this is equivalent to the LZMA_STREAM_INIT */
+	memset(&ls, 0, sizeof (ls));
+	if (lzma_stream_decoder(&ls, ~(uint64_t)(0),
+				LZMA_CONCATENATED) != LZMA_OK) {
+		std::cerr << "lzma_stream_decoder: error!\n";
+		return (1);
+	}
+	if ((output = acquire_buffer()) == NULL) {
+		lzma_end(&ls);
+		return (0);
+	}
+	ls.next_out = (uint8_t *)(output);
+	ls.avail_out = buffer_size;
+	for (;;) {
+		if ((ls.avail_in == 0) && (input_end == 0)) {
+			if ((read_retval = read_input(&bytes_read)) > 0) {
+				retval = 1;
+				break;
+			}
+			input_end = (read_retval != 0);
+			ls.next_in = (const uint8_t *)(input);
+			ls.avail_in = bytes_read;
+		}
+		if (input_end != 0) {
+			action = LZMA_FINISH;
+		}
+		lzma_retval = lzma_code(&ls, action);
+		if (lzma_retval == LZMA_STREAM_END) {
+			break;
+		} else if (lzma_retval != LZMA_OK) {
+			std::cerr << "Error: The xz-compressed input file "
+				"is " << ((lzma_retval == LZMA_BUF_ERROR) ?
+						"truncated" : "corrupted") <<
+				"!\n";
+			retval = 1;
+			break;
+		}
+		if (ls.avail_out == 0) {
+			publish_buffer(buffer_size);
+			if ((output = acquire_buffer()) == NULL) {
+				break;
+			}
+			ls.next_out = (uint8_t *)(output);
+			ls.avail_out = buffer_size;
+		}
+	}
+	if ((output != NULL) && (ls.avail_out < buffer_size)) {
+		publish_buffer(buffer_size - ls.avail_out);
+	}
+	lzma_end(&ls);
+	return (retval);
+}
+
+/* regular functions */
+
+/**
+ * A function which detects the compression format
+ * from the first bytes of the input file.
+ *
+ * @param
+ * magic	the first bytes of the input file
+ * @param
+ * size		the number of the provided bytes
+ *
+ * @return	This function returns the detected compression format,
+ * 		or COMPRESSION_NONE if the input is not compressed.
+ */
+int detect_compression (const unsigned char *magic, size_t size) {
+	static const unsigned char xz_magic[6] = {
+		0xFD, '7', 'z', 'X', 'Z', 0x00
+	};
+	if ((size >= 2) && (magic[0] == 0x1F) && (magic[1] == 0x8B)) {
+		return (COMPRESSION_GZIP);
+	}
+	if ((size >= 6) && (memcmp(magic, xz_magic, 6) == 0)) {
+		return (COMPRESSION_XZ);
+	}
+	return (COMPRESSION_NONE);
+}
+
+/**
+ * @param
+ * format	the compression format
+ *
+ * @return	This function returns the name of the compression format.
+ */
+const char *compression_name (int format) {
+	switch (format) {
+		case COMPRESSION_GZIP:
+			return ("gzip");
+		case COMPRESSION_XZ:
+			return ("xz");
+	}
+	return ("none");
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator character distribution.
+ * This file contains the implementation of the class,
+ * which holds the table used to pick the output characters
+ * according to the probability of their occurrences.
+ */
+
+#include "distribution.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <sys/mman.h>
+
+/* member functions */
+
+distribution::distribution () :
+		owned_cumulative(NULL),
+		owned_symbols(NULL),
+		mapping(NULL),
+		mapping_size(0),
+		cumulative_table(NULL),
+		symbol_table(NULL),
+		symbol_count(0) {
+}
+
+distribution::~distribution () {
+	release();
+}
+
+/**
+ * A member function which releases the arrays
+ * or the memory mapping owned by this distribution.
+ */
+void distribution::release () {
+	delete[] owned_cumulative;
+	delete[] owned_symbols;
+	owned_cumulative = NULL;
+	owned_symbols = NULL;
+	if ((mapping != NULL) && (munmap(mapping, mapping_size) == (-1))) {
+		perror("distribution: munmap");
+		/* resetting the errno */
+		errno = 0;
+	}
+	mapping = NULL;
+	mapping_size = 0;
+	cumulative_table = NULL;
+	symbol_table = NULL;
+	symbol_count = 0;
+}
+
+/**
+ * A member function which builds this distribution
+ * from the numbers of character occurrences.
+ *
+ * @param
+ * occurrences	a std::map of the numbers of character occurrences
+ *
+ * @return	If the distribution has been successfully built,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int distribution::build (const occurrences_map &occurrences) {
+	uint64_t cum_sum = 0;
+	size_t i = 0;
+	release();
+	try {
+		owned_cumulative = new uint64_t[occurrences.size()];
+		owned_symbols = new uint32_t[occurrences.size()];
+	} catch (std::bad_alloc &) {
+		std::cerr << "distribution allocation error!\n";
+		release();
+		return (1);
+	}
+	for (occurrences_map::const_iterator it = occurrences.begin();
+			it != occurrences.end(); ++it) {
+		cum_sum += it->second;
+		owned_cumulative[i] = cum_sum;
+		owned_symbols[i] = (uint32_t)(it->first);
+		++i;
+	}
+	cumulative_table = owned_cumulative;
+	symbol_table = owned_symbols;
+	symbol_count = occurrences.size();
+	return (0);
+}
+
+/**
+ * A member function which makes this distribution use the arrays
+ * contained in the provided memory mapping. The mapping
+ * will be unmapped when this distribution is destroyed.
+ *
+ * @param
+ * mapping	the memory mapping containing the arrays
+ * @param
+ * mapping_size	the size of the memory mapping
+ * @param
+ * cumulative	the cumulative sums of the numbers of occurrences
+ * @param
+ * symbols	the symbols
+ * @param
+ * symbol_count	the number of symbols
+ */
+void distribution::adopt_mapping (void *mapping,
+		size_t mapping_size,
+		const uint64_t *cumulative,
+		const uint32_t *symbols,
+		size_t symbol_count) {
+	release();
+	this->mapping = mapping;
+	this->mapping_size = mapping_size;
+	this->cumulative_table = cumulative;
+	this->symbol_table = symbols;
+	this->symbol_count = symbol_count;
+}
+
+/**
+ * @return	This function returns the number of symbols.
+ */
+size_t distribution::size () const {
+	return (symbol_count);
+}
+
+/**
+ * @return	This function returns the total number
+ * 		of character occurrences.
+ */
+uint64_t distribution::total () const {
+	if (symbol_count == 0) {
+		return (0);
+	}
+	return (cumulative_table[symbol_count - 1]);
+}
+
+/**
+ * @return	If all the symbols have the same number of occurrences,
+ * 		this function returns one (1).
+ * 		Otherwise, it returns zero.
+ */
+int distribution::uniform () const {
+	for (size_t i = 1; i < symbol_count; ++i) {
+		if (cumulative_table[i] != cumulative_table[0] * (i + 1)) {
+			return (0);
+		}
+	}
+	return ((symbol_count > 0) ? 1 : 0);
+}
+
+/**
+ * @return	This function returns the array of the cumulative sums
+ * 		of the numbers of occurrences.
+ */
+const uint64_t *distribution::cumulative () const {
+	return (cumulative_table);
+}
+
+/**
+ * @return	This function returns the array of the symbols.
+ */
+const uint32_t *distribution::symbols () const {
+	return (symbol_table);
+}
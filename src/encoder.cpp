@@ -0,0 +1,1107 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator output encoder.
+ * This file contains the implementation of the class and functions,
+ * which are used to encode the generated characters
+ * without converting them by the iconv one by one.
+ */
+
+#include "encoder.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iconv.h>
+#include <iostream>
+#include <map>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+/* the SSSE3 byte shuffle kernel can be compiled */
+#define ENCODER_SSSE3
+#endif
+
+/* constants */
+
+/* the size of the buffer of a single symbol converted by the iconv */
+static const size_t encoder_symbol_buffer_size = 64;
+
+/* the number of symbol indices generated at once, fits in the L1 cache */
+static const size_t encoder_index_chunk = 16384;
+
+/* data types */
+
+/* the tables of the symbols encoded by an earlier build */
+struct encoded_alphabet {
+	/* the value returned by the build */
+	int retval;
+	std::string slots;
+	std::string lengths;
+};
+
+/*
+ * the encoded alphabets by the output encoding,
+ * the internal encoding and the symbols
+ */
+typedef std::map<std::string, encoded_alphabet> encoded_alphabet_map;
+
+/* global variables */
+
+/* indicates whether the encoded alphabets are cached */
+static int encoder_cache_enabled = 0;
+
+/* the cached encoded alphabets */
+static encoded_alphabet_map encoder_cache;
+
+/* member functions */
+
+symbol_encoder::symbol_encoder () :
+		slot_table(NULL),
+		length_table(NULL),
+		symbol_count(0),
+		longest(0),
+		length_divisor(0) {
+}
+
+symbol_encoder::~symbol_encoder () {
+	release();
+}
+
+/**
+ * A member function which releases the tables.
+ */
+void symbol_encoder::release () {
+	delete[] slot_table;
+	delete[] length_table;
+	slot_table = NULL;
+	length_table = NULL;
+	symbol_count = 0;
+	longest = 0;
+	length_divisor = 0;
+}
+
+/**
+ * A member function which enables caching the tables of the encoded
+ * symbols, so that building the table of the same symbols
+ * in the same encoding again does not need the iconv.
+ * It is meant for the processes generating many outputs.
+ * The cache is never emptied.
+ */
+void symbol_encoder::enable_cache () {
+	encoder_cache_enabled = 1;
+}
+
+/**
+ * A member function which completes the tables derived
+ * from the lengths of the encoded symbols.
+ */
+void symbol_encoder::complete () {
+	size_t position = 0;
+	size_t length = 0;
+	size_t i = 0;
+	/* the byte counts, which are sums of the symbol lengths */
+	memset(reachable_table, 0, sizeof (reachable_table));
+	reachable_table[0] = 1;
+	for (position = 1; position <= reachable_limit; ++position) {
+		for (length = 1; length <= slot_size; ++length) {
+			if ((length <= position) &&
+					(reachable_table[position - length]
+					 != 0) && (memchr(length_table,
+						 (int)(length),
+						 symbol_count) != NULL)) {
+				reachable_table[position] = 1;
+				break;
+			}
+		}
+	}
+	/* the Euclidean algorithm */
+	for (i = 0; i < symbol_count; ++i) {
+		length = length_table[i];
+		while (length != 0) {
+			position = length_divisor % length;
+			length_divisor = length;
+			length = position;
+		}
+	}
+	memset(byte_table, 0, sizeof (byte_table));
+	if ((longest == 1) && (symbol_count <= index_limit)) {
+		for (i = 0; i < symbol_count; ++i) {
+			byte_table[i] = slot_table[i * slot_size];
+		}
+	}
+}
+
+/**
+ * A function which converts the wide characters
+ * by the iconv, including the bytes, which return
+ * the conversion descriptor to its initial state.
+ *
+ * @param
+ * cd		the iconv conversion descriptor
+ * @param
+ * input	the wide characters
+ * @param
+ * input_size	the number of the wide characters
+ * @param
+ * output	the output buffer
+ * @param
+ * output_size	the size of the output buffer
+ * @param
+ * written_bytes	when this function returns, this variable
+ * 			will be set to the number of written bytes
+ *
+ * @return	If all the characters have been reversibly converted,
+ * 		this function returns zero.
+ * 		Otherwise, it returns (-1).
+ */
+static int encode_characters (iconv_t cd,
+		const wchar_t *input,
+		size_t input_size,
+		char *output,
+		size_t output_size,
+		size_t *written_bytes) {
+	/* the iconv does not modify the input, despite its prototype */
+	char *inbuf = (char *)(const_cast<wchar_t *>(input));
+	char *outbuf = output;
+	size_t inbytesleft = input_size * sizeof (wchar_t);
+	size_t outbytesleft = output_size;
+	size_t iconv_retval = 0;
+	/* starting in the initial state */
+	iconv(cd, NULL, NULL, NULL, NULL);
+	iconv_retval = iconv(cd, &inbuf, &inbytesleft, &outbuf, &outbytesleft);
+	if ((iconv_retval != 0) || (iconv(cd, NULL, NULL,
+					&outbuf, &outbytesleft) != 0)) {
+		/* resetting the errno */
+		errno = 0;
+		return (-1);
+	}
+	(*written_bytes) = output_size - outbytesleft;
+	return (0);
+}
+
+/**
+ * A member function which encodes all the symbols of the distribution
+ * in the output character encoding. The encoding is considered
+ * stateless if the encoding of all the symbols at once is equal
+ * to the concatenation of the encodings of the individual symbols.
+ * Otherwise, like with the byte order marks or the shift sequences,
+ * the table is not built. If the cache is enabled, the tables
+ * built before for the same symbols and encoding are reused.
+ *
+ * @param
+ * dist		the distribution
+ * @param
+ * output_encoding	the output character encoding
+ * @param
+ * internal_character_encoding	the encoding of the wchar_t characters
+ *
+ * @return	If the table has been successfully built,
+ * 		this function returns zero.
+ * 		If the output encoding is not stateless,
+ * 		or if a symbol can not be reversibly encoded
+ * 		into a single slot, this function returns (-1).
+ * 		Otherwise, it returns one (1).
+ */
+int symbol_encoder::build (const distribution &dist,
+		const char *output_encoding,
+		const char *internal_character_encoding) {
+	iconv_t cd = (iconv_t)(-1);
+	const uint32_t *symbols = dist.symbols();
+	wchar_t *alphabet = NULL;
+	char *alphabet_encoded = NULL;
+	char symbol_encoded[encoder_symbol_buffer_size];
+	size_t length = 0;
+	size_t total_length = 0;
+	size_t position = 0;
+	size_t i = 0;
+	int retval = 0;
+	std::string key;
+	encoded_alphabet_map::const_iterator cached;
+	release();
+	if (encoder_cache_enabled != 0) {
+		key = std::string(output_encoding) + '\0' +
+			internal_character_encoding + '\0' +
+			std::string((const char *)(symbols),
+					dist.size() * sizeof (uint32_t));
+		cached = encoder_cache.find(key);
+	}
+	if ((encoder_cache_enabled != 0) && (cached != encoder_cache.end())) {
+		if (cached->second.retval != 0) {
+			return (cached->second.retval);
+		}
+		try {
+			slot_table = new unsigned char[dist.size() * slot_size];
+			length_table = new unsigned char[dist.size()];
+		} catch (std::bad_alloc &) {
+			std::cerr << "symbol_encoder allocation error!\n";
+			release();
+			return (1);
+		}
+		memcpy(slot_table, cached->second.slots.data(),
+				dist.size() * slot_size);
+		memcpy(length_table, cached->second.lengths.data(),
+				dist.size());
+		symbol_count = dist.size();
+		longest = *std::max_element(length_table,
+				length_table + symbol_count);
+		complete();
+		return (0);
+	}
+	if ((cd = iconv_open(output_encoding,
+			internal_character_encoding)) == (iconv_t)(-1)) {
+		perror("symbol_encoder: iconv_open");
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	try {
+		slot_table = new unsigned char[dist.size() * slot_size];
+		length_table = new unsigned char[dist.size()];
+		alphabet = new wchar_t[dist.size()];
+	} catch (std::bad_alloc &) {
+		std::cerr << "symbol_encoder allocation error!\n";
+		retval = 1;
+	}
+	for (i = 0; (retval == 0) && (i < dist.size()); ++i) {
+		alphabet[i] = (wchar_t)(symbols[i]);
+		if ((encode_characters(cd, alphabet + i, 1, symbol_encoded,
+				encoder_symbol_buffer_size, &length) != 0) ||
+				(length == 0) || (length > slot_size)) {
+			retval = (-1);
+			break;
+		}
+		memset(slot_table + i * slot_size, 0, slot_size);
+		memcpy(slot_table + i * slot_size, symbol_encoded, length);
+		length_table[i] = (unsigned char)(length);
+		total_length += length;
+		longest = std::max(longest, length);
+	}
+	/* checking whether the encoding is stateless */
+	if (retval == 0) {
+		try {
+			alphabet_encoded = new char[total_length +
+				encoder_symbol_buffer_size];
+		} catch (std::bad_alloc &) {
+			std::cerr << "symbol_encoder allocation error!\n";
+			retval = 1;
+		}
+	}
+	if ((retval == 0) && ((encode_characters(cd, alphabet, dist.size(),
+				alphabet_encoded, total_length +
+				encoder_symbol_buffer_size, &length) != 0) ||
+				(length != total_length))) {
+		retval = (-1);
+	}
+	for (i = 0; (retval == 0) && (i < dist.size()); ++i) {
+		if (memcmp(alphabet_encoded + position,
+				slot_table + i * slot_size,
+				length_table[i]) != 0) {
+			retval = (-1);
+		}
+		position += length_table[i];
+	}
+	delete[] alphabet_encoded;
+	delete[] alphabet;
+	if (iconv_close(cd) == (-1)) {
+		perror("symbol_encoder: iconv_close");
+		/* resetting the errno */
+		errno = 0;
+		retval = 1;
+	}
+	if (retval != 0) {
+		release();
+		/* the encoding, which is not stateless, stays such */
+		if ((encoder_cache_enabled != 0) && (retval < 0)) {
+			encoder_cache[key].retval = retval;
+		}
+		return (retval);
+	}
+	symbol_count = dist.size();
+	if (encoder_cache_enabled != 0) {
+		encoded_alphabet &entry = encoder_cache[key];
+		entry.retval = 0;
+		entry.slots.assign((const char *)(slot_table),
+				symbol_count * slot_size);
+		entry.lengths.assign((const char *)(length_table),
+				symbol_count);
+	}
+	complete();
+	return (0);
+}
+
+/**
+ * @return	This function returns the number of encoded symbols.
+ */
+size_t symbol_encoder::size () const {
+	return (symbol_count);
+}
+
+/**
+ * @return	This function returns the number of bytes
+ * 		of the longest encoded symbol.
+ */
+size_t symbol_encoder::max_length () const {
+	return (longest);
+}
+
+/**
+ * @return	This function returns the number of bytes of every
+ * 		encoded symbol, or zero if their lengths differ.
+ */
+size_t symbol_encoder::fixed_length () const {
+	/* only the equal lengths have the longest one as their divisor */
+	return (((symbol_count > 0) && (length_divisor == longest)) ?
+			longest : 0);
+}
+
+/**
+ * @return	This function returns the table of the encoded symbols,
+ * 		slot_size bytes per symbol.
+ */
+const unsigned char *symbol_encoder::slots () const {
+	return (slot_table);
+}
+
+/**
+ * @return	This function returns the numbers of bytes
+ * 		of the encoded symbols.
+ */
+const unsigned char *symbol_encoder::lengths () const {
+	return (length_table);
+}
+
+/**
+ * A member function which determines whether the specified
+ * number of bytes can be exactly filled by the encoded symbols.
+ *
+ * @param
+ * bytes	the number of bytes
+ *
+ * @return	If the number of bytes is a sum of the lengths
+ * 		of the encoded symbols, this function returns one (1).
+ * 		Otherwise, it returns zero.
+ */
+int symbol_encoder::reachable (size_t bytes) const {
+	if (symbol_count == 0) {
+		return ((bytes == 0) ? 1 : 0);
+	}
+	if (bytes <= reachable_limit) {
+		return (reachable_table[bytes]);
+	}
+	return ((bytes % length_divisor == 0) ? 1 : 0);
+}
+
+/**
+ * @return	This function returns the table of the symbols encoded
+ * 		in a single byte, padded by zeros to index_limit bytes,
+ * 		or NULL if some symbol is encoded in several bytes,
+ * 		or if there are more than index_limit symbols.
+ */
+const unsigned char *symbol_encoder::bytes () const {
+	if ((longest == 1) && (symbol_count <= index_limit)) {
+		return (byte_table);
+	}
+	return (NULL);
+}
+
+/* functions */
+
+#ifdef ENCODER_SSSE3
+/**
+ * A function which determines whether the processor
+ * supports the SSSE3 instructions.
+ *
+ * @return	If the SSSE3 instructions are supported,
+ * 		this function returns one (1).
+ * 		Otherwise, it returns zero.
+ */
+static int ssse3_supported () {
+	static int supported = (-1);
+	if (supported < 0) {
+		__builtin_cpu_init();
+		supported = (__builtin_cpu_supports("ssse3") != 0) ? 1 : 0;
+	}
+	return (supported);
+}
+
+/**
+ * A function which translates the symbol indices to the single-byte
+ * encoded symbols by the SSSE3 byte shuffles, 16 indices at once.
+ * The byte table is split into the 16-byte registers.
+ * The low nibble of an index selects the byte within every register
+ * and the high nibble selects the register.
+ *
+ * @param
+ * indices	the symbol indices
+ * @param
+ * count	the number of the symbol indices
+ * @param
+ * table	the single-byte encoded symbols,
+ * 		padded by zeros to symbol_encoder::index_limit bytes
+ * @param
+ * symbol_count	the number of symbols
+ * @param
+ * output	the output buffer
+ */
+__attribute__((target("ssse3")))
+static void translate_indices_ssse3 (const unsigned char *indices,
+		size_t count,
+		const unsigned char *table,
+		size_t symbol_count,
+		char *output) {
+	__m128i tables[symbol_encoder::index_limit / 16];
+	const __m128i low_mask = _mm_set1_epi8(0x0F);
+	__m128i index;
+	__m128i low;
+	__m128i high;
+	__m128i result;
+	size_t table_count = (symbol_count + 15) / 16;
+	size_t i = 0;
+	size_t k = 0;
+	for (k = 0; k < table_count; ++k) {
+		tables[k] = _mm_loadu_si128((const __m128i *)(table + k * 16));
+	}
+	if (table_count == 1) {
+		/* the indices are lower than 16, so they select directly */
+		for (i = 0; i + 16 <= count; i += 16) {
+			index = _mm_loadu_si128((const __m128i *)
+					(indices + i));
+			_mm_storeu_si128((__m128i *)(output + i),
+					_mm_shuffle_epi8(tables[0], index));
+		}
+	} else {
+		for (i = 0; i + 16 <= count; i += 16) {
+			index = _mm_loadu_si128((const __m128i *)
+					(indices + i));
+			low = _mm_and_si128(index, low_mask);
+			high = _mm_and_si128(_mm_srli_epi16(index, 4),
+					low_mask);
+			result = _mm_setzero_si128();
+			for (k = 0; k < table_count; ++k) {
+				result = _mm_or_si128(result, _mm_and_si128(
+						_mm_shuffle_epi8(tables[k], low),
+						_mm_cmpeq_epi8(high,
+							_mm_set1_epi8(
+								(char)(k)))));
+			}
+			_mm_storeu_si128((__m128i *)(output + i), result);
+		}
+	}
+	for (; i < count; ++i) {
+		output[i] = (char)(table[indices[i]]);
+	}
+}
+#endif /* ENCODER_SSSE3 */
+
+/**
+ * @return	This function returns the description of the way
+ * 		the generated symbols are encoded.
+ */
+const char *symbol_encoder::kernel () const {
+	if (symbol_count > index_limit) {
+		return ("symbol table");
+	} else if (bytes() == NULL) {
+		return ("symbol indices, symbol table");
+	}
+#ifdef ENCODER_SSSE3
+	if (ssse3_supported() != 0) {
+		return ("symbol indices, SSSE3 byte shuffle");
+	}
+#endif /* ENCODER_SSSE3 */
+	return ("symbol indices, byte table");
+}
+
+/**
+ * A function which translates the symbol indices
+ * to the encoded symbols.
+ *
+ * @param
+ * indices	the symbol indices
+ * @param
+ * count	the number of the symbol indices
+ * @param
+ * encoder	the table of the encoded symbols
+ * @param
+ * output	the output buffer, which has to be able to hold
+ * 		count * encoder.max_length() + symbol_encoder::slot_size
+ * 		bytes
+ *
+ * @return	This function returns the position in the output buffer
+ * 		following the last encoded symbol.
+ */
+static char *translate_indices (const unsigned char *indices,
+		size_t count,
+		const symbol_encoder &encoder,
+		char *output) {
+	const unsigned char *table = encoder.bytes();
+	const unsigned char *slots = encoder.slots();
+	const unsigned char *lengths = encoder.lengths();
+	size_t i = 0;
+	if (table != NULL) {
+#ifdef ENCODER_SSSE3
+		if (ssse3_supported() != 0) {
+			translate_indices_ssse3(indices, count, table,
+					encoder.size(), output);
+			return (output + count);
+		}
+#endif /* ENCODER_SSSE3 */
+		for (i = 0; i < count; ++i) {
+			output[i] = (char)(table[indices[i]]);
+		}
+		return (output + count);
+	}
+	for (i = 0; i < count; ++i) {
+		memcpy(output, slots + indices[i] * symbol_encoder::slot_size,
+				symbol_encoder::slot_size);
+		output += lengths[indices[i]];
+	}
+	return (output);
+}
+
+/**
+ * A function which picks a pseudorandom symbol of the distribution.
+ *
+ * @param
+ * cumulative	the cumulative sums of the numbers of occurrences
+ * @param
+ * cumulative_end	the end of the cumulative sums
+ * @param
+ * scale_factor	the factor used to scale the pseudorandom numbers
+ * 		to the total number of occurrences
+ *
+ * @return	This function returns the index of the picked symbol,
+ * 		or the number of symbols if none could be picked.
+ */
+static inline size_t pick_symbol (const uint64_t *cumulative,
+		const uint64_t *cumulative_end,
+		double scale_factor) {
+	/*
+	 * FIXME: we suppose that the total number
+	 * of input characters is not higher
+	 * than the UINT_MAX, roughly.
+	 */
+	unsigned int pseudorandom_number =
+		(unsigned int)(rsgen::get_instance()->next());
+	/* rounding and enforcing strictly positive integers */
+	pseudorandom_number = (unsigned int)
+		((double)(pseudorandom_number) * scale_factor + 1.5);
+	return ((size_t)(std::lower_bound(cumulative, cumulative_end,
+				(uint64_t)(pseudorandom_number)) -
+				cumulative));
+}
+
+/**
+ * A function which fills the output buffer with the encoded
+ * pseudorandom characters from the provided distribution.
+ * The output buffer has to be able to hold
+ * characters * encoder.max_length() + symbol_encoder::slot_size bytes,
+ * because the whole slot is always copied.
+ *
+ * @param
+ * buffer	the output buffer
+ * @param
+ * characters	the number of characters to generate
+ * @param
+ * dist		the distribution
+ * @param
+ * encoder	the table of the symbols of the distribution encoded
+ * 		in the output character encoding
+ * @param
+ * scale_factor	the factor used to scale the pseudorandom numbers
+ * 		to the total number of occurrences
+ * @param
+ * written_bytes	when this function returns, this variable
+ * 			will be set to the number of written bytes
+ *
+ * @return	If the output buffer has been successfully filled,
+ * 		this function returns zero.
+ * 		Otherwise, a positive error number is returned.
+ */
+int fill_output_buffer (char *buffer,
+		size_t characters,
+		const distribution &dist,
+		const symbol_encoder &encoder,
+		double scale_factor,
+		size_t *written_bytes) {
+	const uint64_t *cumulative = dist.cumulative();
+	const uint64_t *cumulative_end = cumulative + dist.size();
+	const unsigned char *slots = encoder.slots();
+	const unsigned char *lengths = encoder.lengths();
+	unsigned char indices[encoder_index_chunk];
+	char *position = buffer;
+	size_t symbol = 0;
+	size_t chunk = 0;
+	size_t i = 0;
+	if (encoder.size() != dist.size()) {
+		std::cerr << "The symbol encoder does not match "
+			"the distribution!\n";
+		return (1);
+	}
+	try {
+		/*
+		 * The small alphabets are generated in two stages:
+		 * the symbol indices first, then their encodings.
+		 */
+		if (dist.size() <= symbol_encoder::index_limit) {
+			for (; characters > 0; characters -= chunk) {
+				chunk = std::min(characters,
+						encoder_index_chunk);
+				for (i = 0; i < chunk; ++i) {
+					symbol = pick_symbol(cumulative,
+							cumulative_end,
+							scale_factor);
+					if (symbol == dist.size()) {
+						break;
+					}
+					indices[i] = (unsigned char)(symbol);
+				}
+				if (i < chunk) {
+					break;
+				}
+				position = translate_indices(indices, chunk,
+						encoder, position);
+			}
+		} else {
+			for (i = 0; i < characters; ++i) {
+				symbol = pick_symbol(cumulative,
+						cumulative_end, scale_factor);
+				if (symbol == dist.size()) {
+					break;
+				}
+				memcpy(position, slots + symbol *
+						symbol_encoder::slot_size,
+						symbol_encoder::slot_size);
+				position += lengths[symbol];
+			}
+		}
+	} catch (...) {
+		std::cerr << "random character selection error!\n";
+		return (2);
+	}
+	if (symbol == dist.size()) {
+		std::cerr << "lower_bound() returned "
+			"the end of the distribution\n";
+		return (1);
+	}
+	(*written_bytes) = (size_t)(position - buffer);
+	return (0);
+}
+
+/**
+ * A function which determines whether the symbols of the distribution
+ * are picked by the random bytes directly, which is the case
+ * for the uniform distributions of at most
+ * symbol_encoder::index_limit symbols. It only depends
+ * on the distribution, so that the same seed picks the same
+ * characters in every output encoding.
+ *
+ * @param
+ * dist		the distribution
+ *
+ * @return	If the symbols are picked by the random bytes,
+ * 		this function returns one (1).
+ * 		Otherwise, it returns zero.
+ */
+int uniform_sampling (const distribution &dist) {
+	return (((dist.uniform() != 0) &&
+				(dist.size() <= symbol_encoder::index_limit)) ?
+			1 : 0);
+}
+
+/**
+ * A function which picks a chunk of the symbol indices uniformly
+ * by the random bytes. The random bytes are used
+ * directly as the symbol indices: their low bits for the alphabets
+ * whose size is a power of two, and the bytes below the largest
+ * multiple of the alphabet size modulo this size for the others,
+ * so that no symbol is preferred.
+ *
+ * @param
+ * indices	the symbol indices
+ * @param
+ * chunk	the number of the symbol indices,
+ * 		at most encoder_index_chunk
+ * @param
+ * symbol_count	the number of symbols,
+ * 		at most symbol_encoder::index_limit
+ */
+static void pick_uniform_chunk (unsigned char *indices,
+		size_t chunk,
+		size_t symbol_count) {
+	unsigned int numbers[encoder_index_chunk / sizeof (unsigned int)];
+	const unsigned char *random_bytes = (const unsigned char *)(numbers);
+	/* the random bytes not lower than this limit are rejected */
+	const size_t limit = 256 - 256 % symbol_count;
+	const unsigned char mask = (unsigned char)(symbol_count - 1);
+	size_t produced = 0;
+	size_t words = 0;
+	size_t i = 0;
+	if ((symbol_count & (symbol_count - 1)) == 0) {
+		words = (chunk + sizeof (unsigned int) - 1) /
+			sizeof (unsigned int);
+		rsgen::get_instance()->fill(numbers, words);
+		for (i = 0; i < chunk; ++i) {
+			indices[i] = random_bytes[i] & mask;
+		}
+		return;
+	}
+	for (produced = 0; produced < chunk; ) {
+		words = (chunk - produced + sizeof (unsigned int) - 1) /
+			sizeof (unsigned int);
+		rsgen::get_instance()->fill(numbers, words);
+		for (i = 0; (i < words * sizeof (unsigned int)) &&
+				(produced < chunk); ++i) {
+			if (random_bytes[i] < limit) {
+				indices[produced++] = (unsigned char)
+					(random_bytes[i] % symbol_count);
+			}
+		}
+	}
+}
+
+/**
+ * A function which fills the output buffer with the pseudorandom
+ * characters picked uniformly from the symbols of the encoder
+ * by the random bytes. The indices are picked by chunks
+ * from the start of the block, so the characters following
+ * the skipped ones are the same as in the whole block.
+ *
+ * @param
+ * buffer	the output buffer
+ * @param
+ * skip		the number of the leading characters,
+ * 		which are picked, but not output
+ * @param
+ * characters	the number of characters to output
+ * @param
+ * encoder	the table of the encoded symbols
+ * @param
+ * written_bytes	when this function returns, this variable
+ * 			will be set to the number of written bytes
+ *
+ * @return	If the output buffer has been successfully filled,
+ * 		this function returns zero.
+ * 		Otherwise, a positive error number is returned.
+ */
+int fill_output_uniform (char *buffer,
+		size_t skip,
+		size_t characters,
+		const symbol_encoder &encoder,
+		size_t *written_bytes) {
+	unsigned char indices[encoder_index_chunk];
+	const size_t symbol_count = encoder.size();
+	const size_t total = skip + characters;
+	char *position = buffer;
+	size_t chunk = 0;
+	size_t first = 0;
+	size_t done = 0;
+	if ((symbol_count == 0) ||
+			(symbol_count > symbol_encoder::index_limit)) {
+		std::cerr << "The uniform output requires "
+			"at most " << symbol_encoder::index_limit <<
+			" symbols!\n";
+		return (1);
+	}
+	try {
+		for (done = 0; done < total; done += chunk) {
+			chunk = std::min(total - done, encoder_index_chunk);
+			pick_uniform_chunk(indices, chunk, symbol_count);
+			if (done + chunk <= skip) {
+				continue;
+			}
+			first = (skip > done) ? (skip - done) : 0;
+			position = translate_indices(indices + first,
+					chunk - first, encoder, position);
+		}
+	} catch (...) {
+		std::cerr << "random character selection error!\n";
+		return (2);
+	}
+	(*written_bytes) = (size_t)(position - buffer);
+	return (0);
+}
+
+/**
+ * A function which fills the buffer of wide characters
+ * with the pseudorandom characters picked uniformly
+ * from the symbols of the distribution by the random bytes,
+ * the same ones as the fill_output_uniform function picks.
+ *
+ * @param
+ * wbuffer	the buffer of wide characters
+ * @param
+ * characters	the number of characters to generate
+ * @param
+ * dist		the uniform distribution
+ *
+ * @return	If the buffer has been successfully filled,
+ * 		this function returns zero.
+ * 		Otherwise, a positive error number is returned.
+ */
+int fill_uniform_wbuffer (wchar_t *wbuffer,
+		size_t characters,
+		const distribution &dist) {
+	unsigned char indices[encoder_index_chunk];
+	const uint32_t *symbols = dist.symbols();
+	size_t chunk = 0;
+	size_t i = 0;
+	try {
+		for (; characters > 0; characters -= chunk) {
+			chunk = std::min(characters, encoder_index_chunk);
+			pick_uniform_chunk(indices, chunk, dist.size());
+			for (i = 0; i < chunk; ++i) {
+				wbuffer[i] = (wchar_t)(symbols[indices[i]]);
+			}
+			wbuffer += chunk;
+		}
+	} catch (...) {
+		std::cerr << "random character selection error!\n";
+		return (2);
+	}
+	return (0);
+}
+
+/**
+ * A function which fills the output buffer
+ * with the raw pseudorandom bytes.
+ *
+ * @param
+ * buffer	the output buffer, aligned for the unsigned int
+ * @param
+ * bytes	the number of bytes to generate
+ *
+ * @return	If the output buffer has been successfully filled,
+ * 		this function returns zero.
+ * 		Otherwise, a positive error number is returned.
+ */
+int fill_output_raw (char *buffer, size_t bytes) {
+	const size_t words = bytes / sizeof (unsigned int);
+	unsigned int last = 0;
+	try {
+		rsgen::get_instance()->fill((unsigned int *)(buffer), words);
+		if (bytes % sizeof (unsigned int) != 0) {
+			rsgen::get_instance()->fill(&last, 1);
+			memcpy(buffer + words * sizeof (unsigned int), &last,
+					bytes % sizeof (unsigned int));
+		}
+	} catch (...) {
+		std::cerr << "random number generation error!\n";
+		return (2);
+	}
+	return (0);
+}
+
+/**
+ * A function which fills the buffer with the indices
+ * of the pseudorandom symbols of the distribution.
+ * The symbols of a uniform distribution are picked by the random bytes,
+ * like by the fill_output_uniform function, so that all the output
+ * files contain the same characters as a single one would.
+ *
+ * @param
+ * indices	the buffer of the symbol indices
+ * @param
+ * characters	the number of characters to generate
+ * @param
+ * dist		the distribution
+ * @param
+ * scale_factor	the factor used to scale the pseudorandom numbers
+ * 		to the total number of occurrences
+ *
+ * @return	If the buffer has been successfully filled,
+ * 		this function returns zero.
+ * 		Otherwise, a positive error number is returned.
+ */
+int fill_symbol_indices (uint32_t *indices,
+		size_t characters,
+		const distribution &dist,
+		double scale_factor) {
+	const uint64_t *cumulative = dist.cumulative();
+	const uint64_t *cumulative_end = cumulative + dist.size();
+	unsigned char chunk_indices[encoder_index_chunk];
+	size_t symbol = 0;
+	size_t chunk = 0;
+	/* the uniform symbols are picked like in the fill_output_uniform */
+	if (uniform_sampling(dist) != 0) {
+		try {
+			for (; characters > 0; characters -= chunk) {
+				chunk = std::min(characters,
+						encoder_index_chunk);
+				pick_uniform_chunk(chunk_indices, chunk,
+						dist.size());
+				for (size_t i = 0; i < chunk; ++i) {
+					indices[i] = chunk_indices[i];
+				}
+				indices += chunk;
+			}
+		} catch (...) {
+			std::cerr << "random character selection error!\n";
+			return (2);
+		}
+		return (0);
+	}
+	try {
+		for (size_t i = 0; i < characters; ++i) {
+			symbol = pick_symbol(cumulative, cumulative_end,
+					scale_factor);
+			if (symbol == dist.size()) {
+				std::cerr << "lower_bound() returned "
+					"the end of the distribution\n";
+				return (1);
+			}
+			indices[i] = (uint32_t)(symbol);
+		}
+	} catch (...) {
+		std::cerr << "random character selection error!\n";
+		return (2);
+	}
+	return (0);
+}
+
+/**
+ * A function which encodes the symbols with the provided indices.
+ *
+ * @param
+ * indices	the symbol indices
+ * @param
+ * count	the number of the symbol indices
+ * @param
+ * encoder	the table of the encoded symbols
+ * @param
+ * output	the output buffer, which has to be able to hold
+ * 		count * encoder.max_length() + symbol_encoder::slot_size
+ * 		bytes
+ *
+ * @return	This function returns the position in the output buffer
+ * 		following the last encoded symbol.
+ */
+char *encode_symbol_indices (const uint32_t *indices,
+		size_t count,
+		const symbol_encoder &encoder,
+		char *output) {
+	const unsigned char *table = encoder.bytes();
+	const unsigned char *slots = encoder.slots();
+	const unsigned char *lengths = encoder.lengths();
+	size_t i = 0;
+	if (table != NULL) {
+		for (i = 0; i < count; ++i) {
+			output[i] = (char)(table[indices[i]]);
+		}
+		return (output + count);
+	}
+	for (i = 0; i < count; ++i) {
+		memcpy(output, slots + (size_t)(indices[i]) *
+				symbol_encoder::slot_size,
+				symbol_encoder::slot_size);
+		output += lengths[indices[i]];
+	}
+	return (output);
+}
+
+/**
+ * A function which makes the block of symbol indices encode
+ * to exactly the target number of bytes. The block is cut
+ * well before the target and the rest is sampled again,
+ * only accepting the symbols, after which the remaining number
+ * of bytes can still be exactly filled. This only affects
+ * the distribution of the last few characters.
+ *
+ * @param
+ * indices	the block of symbol indices, which has to be able
+ * 		to hold symbol_encoder::reachable_limit + slot_size
+ * 		more indices than it contains
+ * @param
+ * characters	the number of indices in the block,
+ * 		it will be updated
+ * @param
+ * bytes	the number of bytes the block encodes to,
+ * 		it will be updated
+ * @param
+ * target_bytes	the target number of bytes,
+ * 		which has to be reachable by the encoder
+ * @param
+ * dist		the distribution
+ * @param
+ * encoder	the table of the encoded symbols
+ * @param
+ * scale_factor	the factor used to scale the pseudorandom numbers
+ * 		to the total number of occurrences
+ *
+ * @return	If the block has been successfully adjusted,
+ * 		this function returns zero.
+ * 		Otherwise, a positive error number is returned.
+ */
+int fill_exact_tail (uint32_t *indices,
+		size_t *characters,
+		size_t *bytes,
+		size_t target_bytes,
+		const distribution &dist,
+		const symbol_encoder &encoder,
+		double scale_factor) {
+	const uint64_t *cumulative = dist.cumulative();
+	const uint64_t *cumulative_end = cumulative + dist.size();
+	const unsigned char *lengths = encoder.lengths();
+	/* the prefix of the block kept as it is */
+	const size_t limit = (target_bytes > symbol_encoder::reachable_limit) ?
+		target_bytes - symbol_encoder::reachable_limit : 0;
+	size_t kept = 0;
+	size_t kept_bytes = 0;
+	size_t symbol = 0;
+	size_t left = 0;
+	if (encoder.reachable(target_bytes) == 0) {
+		std::cerr << "The exact size of " << target_bytes <<
+			" bytes can not be reached\n"
+			"by the encoded characters!\n";
+		return (1);
+	}
+	while ((kept < (*characters)) &&
+			(kept_bytes + lengths[indices[kept]] <= limit)) {
+		kept_bytes += lengths[indices[kept]];
+		++kept;
+	}
+	try {
+		while (kept_bytes < target_bytes) {
+			symbol = pick_symbol(cumulative, cumulative_end,
+					scale_factor);
+			if (symbol == dist.size()) {
+				std::cerr << "lower_bound() returned "
+					"the end of the distribution\n";
+				return (1);
+			}
+			left = target_bytes - kept_bytes;
+			if ((lengths[symbol] <= left) && (encoder.reachable(
+						left - lengths[symbol]) != 0)) {
+				indices[kept] = (uint32_t)(symbol);
+				kept_bytes += lengths[symbol];
+				++kept;
+			}
+		}
+	} catch (...) {
+		std::cerr << "random character selection error!\n";
+		return (2);
+	}
+	(*characters) = kept;
+	(*bytes) = kept_bytes;
+	return (0);
+}
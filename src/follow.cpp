@@ -0,0 +1,463 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator corpus follower.
+ * This file contains the implementation of the class,
+ * which keeps the distribution up to date with the characters
+ * appended to a growing input file.
+ */
+
+#include "follow.h"
+#include "decoder.h"
+#include "decompress.h"
+#include "ingest.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* constants */
+
+/* the number of wide characters decoded at once by the iconv */
+static const size_t follow_wbuffer_size = 65536;
+
+/* member functions */
+
+corpus_follower::corpus_follower () :
+		fd(-1),
+		inotify_fd(-1),
+		offset(0),
+		unused(0),
+		buffer(NULL),
+		wbuffer(NULL),
+		decoder(BUILTIN_DECODER_NONE),
+		cd((iconv_t)(-1)),
+		appended(NULL),
+		appended_count(0),
+		update_count(0),
+		initial(NULL),
+		published(NULL),
+		in_use(NULL),
+		stopped(0),
+		started(0) {
+}
+
+corpus_follower::~corpus_follower () {
+	stop();
+	reclaim(1);
+	if ((published != NULL) && (published != initial)) {
+		delete published;
+	}
+	delete appended;
+	delete[] wbuffer;
+	delete[] buffer;
+	if ((inotify_fd != (-1)) && (close(inotify_fd) == (-1))) {
+		perror("corpus_follower: close");
+		/* resetting the errno */
+		errno = 0;
+	}
+	if ((cd != (iconv_t)(-1)) && (iconv_close(cd) == (-1))) {
+		perror("corpus_follower: iconv_close");
+		/* resetting the errno */
+		errno = 0;
+	}
+}
+
+/**
+ * A member function which starts following the input file.
+ *
+ * @param
+ * path		the path of the input file
+ * @param
+ * fd		the file descriptor of the input file,
+ * 		which has to stay open while it is being followed
+ * @param
+ * offset	the number of bytes of the input file
+ * 		already counted in the occurrences
+ * @param
+ * input_encoding	the character encoding of the input file
+ * @param
+ * internal_character_encoding	the encoding of the wchar_t characters
+ * @param
+ * occurrences	the numbers of occurrences of the characters
+ * 		in the first 'offset' bytes of the input file
+ * @param
+ * initial	the distribution built from the occurrences,
+ * 		it will be published until the first update
+ *
+ * @return	If the input file is being followed,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int corpus_follower::start (const char *path,
+		int fd,
+		size_t offset,
+		const char *input_encoding,
+		const char *internal_character_encoding,
+		const occurrences_map &occurrences,
+		const distribution *initial) {
+	struct stat input_stat;
+	unsigned char magic[8];
+	ssize_t pread_retval = 0;
+	int pthread_retval = 0;
+	if ((fstat(fd, &input_stat) == (-1)) ||
+			(!S_ISREG(input_stat.st_mode))) {
+		std::cerr << "Only a regular input file can be followed!\n";
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	pread_retval = pread(fd, magic, sizeof (magic), 0);
+	if ((pread_retval > 0) && (detect_compression(magic,
+				(size_t)(pread_retval)) != COMPRESSION_NONE)) {
+		std::cerr << "A compressed input file can not be followed!\n";
+		return (1);
+	}
+	this->path = path;
+	this->fd = fd;
+	this->offset = offset;
+	this->initial = initial;
+	published = initial;
+	in_use = initial;
+	base = occurrences;
+	decoder = select_builtin_decoder(input_encoding);
+	if ((decoder == BUILTIN_DECODER_NONE) &&
+			((cd = iconv_open(internal_character_encoding,
+					  input_encoding)) == (iconv_t)(-1))) {
+		perror("corpus_follower: iconv_open");
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	try {
+		buffer = new char[buffer_size];
+		wbuffer = new wchar_t[follow_wbuffer_size];
+		appended = new character_histogram();
+	} catch (std::bad_alloc &) {
+		std::cerr << "corpus_follower: allocation error!\n";
+		return (1);
+	}
+	if (((inotify_fd = inotify_init()) == (-1)) ||
+			(inotify_add_watch(inotify_fd, path,
+				IN_MODIFY | IN_CLOSE_WRITE |
+				IN_DELETE_SELF | IN_MOVE_SELF) == (-1))) {
+		perror("corpus_follower: inotify");
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	pthread_retval = pthread_create(&thread, NULL, follower_main, this);
+	if (pthread_retval != 0) {
+		std::cerr << "corpus_follower: pthread_create: " <<
+			strerror(pthread_retval) << "\n";
+		return (1);
+	}
+	started = 1;
+	return (0);
+}
+
+/**
+ * A member function which returns the currently published
+ * distribution and announces it as being in use.
+ * The previously acquired distribution may be destroyed
+ * after this call, so it must not be used anymore.
+ * This function may only be called by a single thread.
+ *
+ * @return	This function returns the published distribution.
+ */
+const distribution *corpus_follower::acquire () {
+	const distribution *current = NULL;
+	/*
+	 * The announcement is only valid if the distribution
+	 * has still been published after it has been made,
+	 * otherwise the follower may have missed it.
+	 */
+	do {
+		current = published;
+		in_use = current;
+		__sync_synchronize();
+	} while (current != published);
+	return (current);
+}
+
+/**
+ * A member function which stops following the input file.
+ *
+ * @return	If the input file has been followed without errors,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int corpus_follower::stop () {
+	void *thread_retval = NULL;
+	if (started == 0) {
+		return (0);
+	}
+	stopped = 1;
+	pthread_join(thread, &thread_retval);
+	started = 0;
+	return ((thread_retval != NULL) ? 1 : 0);
+}
+
+/**
+ * @return	This function returns the number of the published updates
+ * 		of the distribution.
+ */
+size_t corpus_follower::updates () const {
+	return (update_count);
+}
+
+/**
+ * @return	This function returns the number of characters
+ * 		appended to the input file while it has been followed.
+ */
+size_t corpus_follower::appended_characters () const {
+	return (appended_count);
+}
+
+/**
+ * The function executed by the follower thread.
+ *
+ * @param
+ * argument	a pointer to the corpus_follower
+ *
+ * @return	This function returns NULL if the input file
+ * 		has been followed without errors, or the argument
+ * 		itself otherwise.
+ */
+void *corpus_follower::follower_main (void *argument) {
+	corpus_follower *cf = (corpus_follower *)(argument);
+	if (cf->follow() != 0) {
+		return (argument);
+	}
+	return (NULL);
+}
+
+/**
+ * A member function which waits for the inotify events
+ * of the input file and updates the distribution,
+ * until it is stopped or the input file disappears.
+ *
+ * @return	If the input file has been followed without errors,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int corpus_follower::follow () {
+	/* the buffer has to be aligned for the struct inotify_event */
+	long events[1024];
+	const struct inotify_event *event = NULL;
+	struct pollfd pfd;
+	ssize_t read_retval = 0;
+	ssize_t position = 0;
+	int changed = 0;
+	int gone = 0;
+	int poll_retval = 0;
+	/* the characters appended before the watch has been added */
+	if (read_appended(&changed) != 0) {
+		return (1);
+	}
+	if ((changed != 0) && (publish() != 0)) {
+		return (1);
+	}
+	while ((stopped == 0) && (gone == 0)) {
+		pfd.fd = inotify_fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		poll_retval = poll(&pfd, 1, poll_interval);
+		if (poll_retval == (-1)) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("corpus_follower: poll");
+			/* resetting the errno */
+			errno = 0;
+			return (1);
+		}
+		if (poll_retval == 0) {
+			continue;
+		}
+		read_retval = read(inotify_fd, events, sizeof (events));
+		if (read_retval == (-1)) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("corpus_follower: read");
+			/* resetting the errno */
+			errno = 0;
+			return (1);
+		}
+		for (position = 0; position < read_retval;
+				position += (ssize_t)(sizeof (struct
+						inotify_event) + event->len)) {
+			event = (const struct inotify_event *)
+				((const char *)(events) + position);
+			if ((event->mask & (IN_DELETE_SELF | IN_MOVE_SELF |
+						IN_IGNORED)) != 0) {
+				gone = 1;
+			}
+		}
+		changed = 0;
+		if (read_appended(&changed) != 0) {
+			return (1);
+		}
+		if ((changed != 0) && (publish() != 0)) {
+			return (1);
+		}
+	}
+	if (gone != 0) {
+		std::clog << "Warning: The followed input file '" << path <<
+			"' has been removed or renamed!\n";
+	}
+	return (0);
+}
+
+/**
+ * A member function which reads, decodes and counts
+ * all the bytes appended to the input file since the last call.
+ * An incomplete character at the end is kept until the rest
+ * of it is appended. If the input file has been truncated,
+ * it is followed from its new end.
+ *
+ * @param
+ * changed	this variable will be set to one (1)
+ * 		if any characters have been counted
+ *
+ * @return	If all the appended bytes have been successfully
+ * 		decoded, this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int corpus_follower::read_appended (int *changed) {
+	struct stat input_stat;
+	ssize_t pread_retval = 0;
+	size_t size = 0;
+	size_t new_unused = 0;
+	size_t characters = 0;
+	int retval = 0;
+	for (;;) {
+		pread_retval = pread(fd, buffer + unused, buffer_size - unused,
+				(off_t)(offset));
+		if (pread_retval == (-1)) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("corpus_follower: pread");
+			/* resetting the errno */
+			errno = 0;
+			return (1);
+		}
+		if (pread_retval == 0) {
+			if ((fstat(fd, &input_stat) == 0) &&
+					((size_t)(input_stat.st_size) < offset)) {
+				std::clog << "Warning: The followed input "
+					"file '" << path << "' has been "
+					"truncated, it is followed\n"
+					"from its new end.\n";
+				offset = (size_t)(input_stat.st_size);
+				unused = 0;
+			}
+			/* resetting the errno */
+			errno = 0;
+			return (0);
+		}
+		offset += (size_t)(pread_retval);
+		size = unused + (size_t)(pread_retval);
+		characters = 0;
+		new_unused = 0;
+		if (decoder != BUILTIN_DECODER_NONE) {
+			retval = decode_builtin(decoder, buffer, size,
+					*appended, &new_unused, &characters);
+		} else {
+			retval = decode_and_count(&cd, buffer, size, wbuffer,
+					follow_wbuffer_size, *appended,
+					&new_unused, &characters);
+		}
+		if (retval > 0) {
+			std::cerr << "Character conversion error in the data "
+				"appended to the input file!\n";
+			return (1);
+		}
+		appended_count += characters;
+		if (characters > 0) {
+			(*changed) = 1;
+		}
+		memmove(buffer, buffer + size - new_unused, new_unused);
+		unused = new_unused;
+	}
+}
+
+/**
+ * A member function which builds the distribution
+ * from all the counted characters and publishes it.
+ *
+ * @return	If the distribution has been successfully published,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int corpus_follower::publish () {
+	occurrences_map occurrences(base);
+	distribution *next = NULL;
+	const distribution *previous = published;
+	appended->fold(occurrences);
+	try {
+		next = new distribution();
+	} catch (std::bad_alloc &) {
+		std::cerr << "corpus_follower: allocation error!\n";
+		return (1);
+	}
+	if (next->build(occurrences) != 0) {
+		delete next;
+		return (1);
+	}
+	__sync_synchronize();
+	published = next;
+	__sync_synchronize();
+	if (previous != initial) {
+		retired.push_back(previous);
+	}
+	++update_count;
+	reclaim(0);
+	return (0);
+}
+
+/**
+ * A member function which destroys the replaced distributions,
+ * which are not in use by the generator.
+ *
+ * @param
+ * all		if nonzero, all the replaced distributions are destroyed,
+ * 		because the generator does not use any of them anymore
+ */
+void corpus_follower::reclaim (int all) {
+	std::vector<const distribution *> kept;
+	const distribution *current = in_use;
+	for (size_t i = 0; i < retired.size(); ++i) {
+		if ((all == 0) && (retired[i] == current)) {
+			kept.push_back(retired[i]);
+		} else {
+			delete retired[i];
+		}
+	}
+	retired.swap(kept);
+}
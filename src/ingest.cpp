@@ -0,0 +1,1453 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator corpus ingest functions.
+ * This file contains the implementation of functions,
+ * which are used to read the input file, decode its characters
+ * and count their occurrences on several threads.
+ */
+
+#include "ingest.h"
+#include "decoder.h"
+#include "decompress.h"
+#include "parallel.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iconv.h>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/* constants */
+
+/* the nominal size of a single chunk of the input, 2 MiB */
+static const size_t ingest_chunk_size = 2097152;
+/* the number of chunks per thread read in a single round */
+static const size_t ingest_chunks_per_thread = 4;
+/* the desired size of the buffer of an input pipe, 16 MiB */
+static const int ingest_pipe_size = 16777216;
+/* the number of wide characters decoded at once by a single thread */
+static const size_t ingest_wbuffer_size = 65536;
+/* the size of a single chunk read when sampling the input, 1 MiB */
+static const size_t sample_chunk_size = 1048576;
+/*
+ * the number of bytes searched for a byte, which can not be a part
+ * of a multi-byte character, before the boundary is found by decoding
+ */
+static const size_t resync_scan_size = 65536;
+/* the number of bytes decoded from each candidate character boundary */
+static const size_t resync_trial_size = 1024;
+/*
+ * the number of the candidate character boundaries,
+ * the length of the longest character of the EUC and DBCS encodings
+ */
+static const size_t resync_candidates = 4;
+/* the minimal number of random groups of the sampled chunks */
+static const size_t sample_min_groups = 16;
+/*
+ * the 97.5% quantiles of the Student's t-distribution
+ * with 1 to 30 degrees of freedom, used for the 95% confidence intervals
+ */
+static const double sample_t_quantiles[30] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+/* auxiliary structures */
+
+/* a single chunk of the input buffer decoded by a single task */
+struct ingest_chunk {
+	const char *data;
+	size_t size;
+	/* the number of bytes of an incomplete character at the end */
+	size_t unused;
+	/* the number of characters decoded from this chunk */
+	size_t characters;
+};
+
+/* the state shared by all the tasks decoding a single input buffer */
+struct ingest_context {
+	/* the per-worker conversion descriptors */
+	iconv_t *cds;
+	/* the per-worker buffers of decoded wide characters */
+	wchar_t **wbuffers;
+	/* the per-worker histograms */
+	character_histogram **histograms;
+	ingest_chunk *chunks;
+	/* the class of the input character encoding */
+	int encoding_class;
+	/* the built-in decoder, or BUILTIN_DECODER_NONE for the iconv */
+	int decoder;
+	/* the maximum number of threads decoding the chunks */
+	size_t thread_count;
+	/* the number of the input bytes read so far */
+	size_t total_bytes;
+	/*
+	 * indicates whether the conversion state should be reset
+	 * at the beginning of each chunk
+	 */
+	int reset_state;
+};
+
+/*
+ * The state shared by all the tasks sampling the input file.
+ * The sampled chunks are split into random groups, the chunk j
+ * belonging to the group (j % group_count). Each group is sampled
+ * by a single task, so all the per-group resources are used
+ * by a single thread at a time.
+ */
+struct sample_context {
+	int fd;
+	int encoding_class;
+	int decoder;
+	size_t file_size;
+	/* the sorted offsets of the sampled chunks */
+	const size_t *offsets;
+	size_t chunk_count;
+	size_t group_count;
+	/* the per-group resources */
+	iconv_t *cds;
+	char **buffers;
+	wchar_t **wbuffers;
+	character_histogram **histograms;
+	size_t *characters;
+	size_t *bytes;
+	/* the per-group numbers of the chunks without a character boundary */
+	size_t *unsynchronized;
+};
+
+/* static functions */
+
+/**
+ * A function which finds a character boundary by decoding,
+ * for the text, whose bytes do not reveal the boundaries,
+ * like the EUC or Shift_JIS text without any ASCII characters.
+ * One of the few positions from the specified one on
+ * has to be a character boundary, so the decoding is tried from each
+ * of them. The true decoding is valid, the ones from the middle
+ * of a character either run into an invalid sequence soon,
+ * or they meet the true one. The first position reached
+ * by all the valid decodings is therefore a character boundary.
+ *
+ * @param
+ * cd	the iconv conversion descriptor of the input encoding,
+ * 	whose conversion state is reset
+ * @param
+ * buffer	the buffer of encoded characters
+ * @param
+ * buffer_size	the number of bytes in the buffer
+ * @param
+ * position	the position from which the boundary is searched for
+ *
+ * @return	This function returns the position of the character
+ * 		boundary. If the valid decodings do not meet
+ * 		soon enough, the buffer_size is returned.
+ */
+static size_t decode_character_boundary (iconv_t cd,
+		const char *buffer,
+		size_t buffer_size,
+		size_t position) {
+	const size_t trial_end = (buffer_size - position > resync_trial_size) ?
+		position + resync_trial_size : buffer_size;
+	/* the numbers of the valid decodings reaching the positions */
+	std::vector<unsigned char> reached(trial_end - position + 1, 0);
+	std::vector<size_t> boundaries;
+	wchar_t character = 0;
+	char *inbuf = NULL;
+	char *outbuf = NULL;
+	size_t inbytesleft = 0;
+	size_t outbytesleft = 0;
+	size_t iconv_retval = 0;
+	size_t valid = 0;
+	size_t i = 0;
+	size_t k = 0;
+	int invalid = 0;
+	for (k = 0; (k < resync_candidates) && (position + k < trial_end);
+			++k) {
+		iconv(cd, NULL, NULL, NULL, NULL);
+		inbuf = (char *)(buffer + position + k);
+		inbytesleft = trial_end - position - k;
+		boundaries.assign(1, position + k);
+		invalid = 0;
+		/* a single character at a time, to learn its boundaries */
+		while (inbytesleft > 0) {
+			outbuf = (char *)(&character);
+			outbytesleft = sizeof (wchar_t);
+			iconv_retval = iconv(cd, &inbuf, &inbytesleft,
+					&outbuf, &outbytesleft);
+			if (iconv_retval == (size_t)(-1)) {
+				/* an incomplete character at the trial end */
+				if (errno == EINVAL) {
+					break;
+				} else if ((errno != E2BIG) ||
+						(outbytesleft != 0)) {
+					invalid = 1;
+					break;
+				}
+			}
+			boundaries.push_back((size_t)(inbuf - buffer));
+		}
+		/* resetting the errno */
+		errno = 0;
+		if (invalid != 0) {
+			continue;
+		}
+		++valid;
+		for (i = 0; i < boundaries.size(); ++i) {
+			++reached[boundaries[i] - position];
+		}
+	}
+	iconv(cd, NULL, NULL, NULL, NULL);
+	for (i = 0; (valid > 0) && (i < reached.size()); ++i) {
+		if (reached[i] == valid) {
+			return (position + i);
+		}
+	}
+	return (buffer_size);
+}
+
+/**
+ * A function which finds the first character boundary
+ * in the provided buffer at or after the specified position,
+ * like the find_character_boundary function. In the EUC
+ * and DBCS encodings, if there is no byte, which can not be a part
+ * of a multi-byte character, near the position,
+ * the boundary is found by decoding.
+ *
+ * @param
+ * encoding_class	the class of the character encoding
+ * 			of the buffer
+ * @param
+ * cd	the iconv conversion descriptor of the input encoding,
+ * 	whose conversion state is reset in the EUC and DBCS encodings
+ * @param
+ * buffer	the buffer of encoded characters
+ * @param
+ * buffer_size	the number of bytes in the buffer
+ * @param
+ * position	the position from which the boundary is searched for
+ *
+ * @return	This function returns the position of the character
+ * 		boundary. If there is no such boundary, or if the boundaries
+ * 		can not be determined for the provided encoding class,
+ * 		the buffer_size is returned.
+ */
+static size_t resynchronize (int encoding_class,
+		iconv_t cd,
+		const char *buffer,
+		size_t buffer_size,
+		size_t position) {
+	size_t scan_end = buffer_size;
+	size_t boundary = 0;
+	if ((encoding_class != ENCODING_CLASS_EUC) &&
+			(encoding_class != ENCODING_CLASS_DBCS)) {
+		return (find_character_boundary(encoding_class, buffer,
+					buffer_size, position));
+	}
+	if ((position < buffer_size) &&
+			(buffer_size - position > resync_scan_size)) {
+		scan_end = position + resync_scan_size;
+	}
+	boundary = find_character_boundary(encoding_class, buffer, scan_end,
+			position);
+	if (boundary < scan_end) {
+		return (boundary);
+	}
+	boundary = decode_character_boundary(cd, buffer, buffer_size,
+			position);
+	if (boundary < buffer_size) {
+		return (boundary);
+	}
+	return (find_character_boundary(encoding_class, buffer, buffer_size,
+				scan_end));
+}
+
+/**
+ * A task which reads and decodes all the sampled chunks
+ * of a single random group. The beginning of each chunk is skipped
+ * up to the first character boundary and an incomplete character
+ * at its end is ignored. A chunk without any character boundary,
+ * which can be determined, is skipped entirely.
+ *
+ * @param
+ * context	a pointer to the sample_context structure
+ * @param
+ * task_index	the index of the group to sample
+ *
+ * @return	If all the chunks of the group have been successfully
+ * 		read and decoded, this function returns zero.
+ * 		Otherwise, a positive error number is returned.
+ */
+static int sample_group_task (void *context,
+		size_t task_index,
+		size_t /* worker_index */) {
+	sample_context *sc = (sample_context *)(context);
+	char *buffer = sc->buffers[task_index];
+	size_t offset = 0;
+	size_t length = 0;
+	size_t got = 0;
+	size_t start = 0;
+	size_t unused = 0;
+	size_t j = 0;
+	ssize_t pread_retval = 0;
+	int retval = 0;
+	for (j = task_index; j < sc->chunk_count; j += sc->group_count) {
+		offset = sc->offsets[j];
+		length = sc->file_size - offset;
+		if (length > sample_chunk_size) {
+			length = sample_chunk_size;
+		}
+		for (got = 0; got < length; got += (size_t)(pread_retval)) {
+			pread_retval = pread(sc->fd, buffer + got,
+					length - got, (off_t)(offset + got));
+			if (pread_retval == (-1)) {
+				if (errno == EINTR) {
+					errno = 0;
+					pread_retval = 0;
+					continue;
+				}
+				perror("sample_group_task: pread");
+				/* resetting the errno */
+				errno = 0;
+				return (1);
+			} else if (pread_retval == 0) {
+				break;
+			}
+		}
+		start = (offset == 0) ? 0 : resynchronize(sc->encoding_class,
+				sc->cds[task_index], buffer, got, 0);
+		/* the character boundaries of this chunk are ambiguous */
+		if ((start == got) && (got > 0)) {
+			++(sc->unsynchronized[task_index]);
+			continue;
+		}
+		if (sc->decoder != BUILTIN_DECODER_NONE) {
+			retval = decode_builtin(sc->decoder, buffer + start,
+					got - start,
+					*(sc->histograms[task_index]),
+					&unused, &(sc->characters[task_index]));
+		} else {
+			iconv(sc->cds[task_index], NULL, NULL, NULL, NULL);
+			retval = decode_and_count(&(sc->cds[task_index]),
+					buffer + start, got - start,
+					sc->wbuffers[task_index],
+					ingest_wbuffer_size,
+					*(sc->histograms[task_index]),
+					&unused, &(sc->characters[task_index]));
+		}
+		/* an incomplete character at the end is simply ignored */
+		if (retval > 0) {
+			return (retval);
+		}
+		sc->bytes[task_index] += got - unused - start;
+	}
+	return (0);
+}
+
+/**
+ * A task which decodes a single chunk of the input buffer
+ * and counts the occurrences of its characters
+ * in the histogram of the executing worker.
+ *
+ * @param
+ * context	a pointer to the ingest_context structure
+ * @param
+ * task_index	the index of the chunk to decode
+ * @param
+ * worker_index	the index of the worker executing this task
+ *
+ * @return	If the chunk has been successfully decoded,
+ * 		this function returns zero.
+ * 		Otherwise, a positive error number is returned.
+ */
+static int ingest_chunk_task (void *context,
+		size_t task_index,
+		size_t worker_index) {
+	ingest_context *ic = (ingest_context *)(context);
+	ingest_chunk *chunk = &(ic->chunks[task_index]);
+	iconv_t *cd = &(ic->cds[worker_index]);
+	int retval = 0;
+	chunk->unused = 0;
+	chunk->characters = 0;
+	if (ic->decoder != BUILTIN_DECODER_NONE) {
+		retval = decode_builtin(ic->decoder, chunk->data, chunk->size,
+				*(ic->histograms[worker_index]),
+				&(chunk->unused), &(chunk->characters));
+	} else {
+		if (ic->reset_state != 0) {
+			iconv((*cd), NULL, NULL, NULL, NULL);
+		}
+		retval = decode_and_count(cd, chunk->data, chunk->size,
+				ic->wbuffers[worker_index],
+				ingest_wbuffer_size,
+				*(ic->histograms[worker_index]),
+				&(chunk->unused), &(chunk->characters));
+	}
+	/* an incomplete character at the end is not an error here */
+	if (retval < 0) {
+		return (0);
+	}
+	return (retval);
+}
+
+/**
+ * A function which splits the provided buffer into chunks
+ * at the character boundaries and decodes them in parallel.
+ * The boundaries are found on the calling thread, using the first
+ * iconv conversion descriptor, before any of the chunks is decoded.
+ * The ic->chunks array has to contain at least 'chunk_count' elements.
+ *
+ * @param
+ * ic	the ingest_context shared by all the tasks
+ * @param
+ * buffer	the buffer of encoded characters
+ * @param
+ * buffer_size	the number of bytes in the buffer
+ * @param
+ * chunk_count	the desired number of chunks
+ * @param
+ * total_characters	the number of the decoded characters
+ * 			will be added to this variable
+ * @param
+ * unused_input_bytes	when this function returns, this variable
+ * 			will be set to the number of bytes
+ * 			of the incomplete character at the end
+ * 			of the buffer
+ *
+ * @return	If all the chunks have been successfully decoded,
+ * 		this function returns zero.
+ * 		Otherwise, in case of any error,
+ * 		a positive error number is returned.
+ */
+static int ingest_buffer (ingest_context *ic,
+		const char *buffer,
+		size_t buffer_size,
+		size_t chunk_count,
+		size_t *total_characters,
+		size_t *unused_input_bytes) {
+	size_t start = 0;
+	size_t end = 0;
+	size_t i = 0;
+	int retval = 0;
+	for (i = 0; i < chunk_count; ++i) {
+		if (i + 1 == chunk_count) {
+			end = buffer_size;
+		} else {
+			end = resynchronize(ic->encoding_class, ic->cds[0],
+					buffer, buffer_size,
+					buffer_size / chunk_count * (i + 1));
+			if (end < start) {
+				end = start;
+			}
+		}
+		ic->chunks[i].data = buffer + start;
+		ic->chunks[i].size = end - start;
+		start = end;
+	}
+	if (run_parallel(ingest_chunk_task, ic,
+				chunk_count, ic->thread_count) != 0) {
+		std::cerr << "Character conversion error!\n";
+		return (1);
+	}
+	for (i = 0; i < chunk_count; ++i) {
+		(*total_characters) += ic->chunks[i].characters;
+		if ((i + 1 < chunk_count) && (ic->chunks[i].unused != 0)) {
+			std::cerr << "Character conversion error "
+				"at a chunk boundary!\n";
+			retval = 1;
+		}
+	}
+	(*unused_input_bytes) = ic->chunks[chunk_count - 1].unused;
+	return (retval);
+}
+
+/**
+ * A function which maps the entire regular input file into memory
+ * and decodes its characters directly from the mapping,
+ * without copying them to any intermediate buffer.
+ *
+ * @param
+ * ic	the ingest_context shared by all the tasks
+ * @param
+ * fd	the file descriptor of the input file
+ * @param
+ * file_size	the size of the input file in bytes
+ * @param
+ * total_characters	the number of the decoded characters
+ * 			will be added to this variable
+ *
+ * @return	If the entire input file has been successfully decoded,
+ * 		this function returns zero.
+ * 		If the input file could not have been mapped,
+ * 		this function returns (-1) and the caller should
+ * 		read the file instead.
+ * 		Otherwise, in case of any error,
+ * 		a positive error number is returned.
+ */
+static int ingest_mapped_file (ingest_context *ic,
+		int fd,
+		size_t file_size,
+		size_t *total_characters) {
+	void *mapping = NULL;
+	size_t unused_input_bytes = 0;
+	size_t chunk_count = 1;
+	int retval = 0;
+	mapping = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (mapping == MAP_FAILED) {
+		/* resetting the errno */
+		errno = 0;
+		return (-1);
+	}
+	/*
+	 * the advice is not essential, so we do not care
+	 * whether it has been accepted or not
+	 */
+	madvise(mapping, file_size, MADV_SEQUENTIAL);
+	madvise(mapping, file_size, MADV_WILLNEED);
+	if (ic->thread_count > 1) {
+		chunk_count = (file_size + ingest_chunk_size - 1) /
+			ingest_chunk_size;
+	}
+	try {
+		ic->chunks = new ingest_chunk[chunk_count];
+	} catch (std::bad_alloc &) {
+		std::cerr << "chunks allocation error!\n";
+		munmap(mapping, file_size);
+		return (1);
+	}
+	retval = ingest_buffer(ic, (const char *)(mapping), file_size,
+			chunk_count, total_characters, &unused_input_bytes);
+	ic->total_bytes += file_size;
+	if ((retval == 0) && (unused_input_bytes != (size_t)(0))) {
+		std::cerr << "Error: The input file ends "
+			"with an incomplete character.\n";
+		retval = 1;
+	}
+	delete[] ic->chunks;
+	ic->chunks = NULL;
+	if (munmap(mapping, file_size) == (-1)) {
+		perror("ingest_mapped_file: munmap");
+		/* resetting the errno */
+		errno = 0;
+		retval = 1;
+	}
+	return (retval);
+}
+
+/**
+ * A function which reads the input file in a loop
+ * into a buffer and decodes each of the read buffers in parallel.
+ * An incomplete character at the end of a buffer is moved
+ * to the beginning of the buffer and decoded in the next round.
+ * If the input file is compressed, the buffers are read
+ * from its decompressor instead.
+ *
+ * @param
+ * ic	the ingest_context shared by all the tasks
+ * @param
+ * fd	the file descriptor of the input file
+ * @param
+ * dc	the decompressor of the input file, or NULL
+ * @param
+ * prefix	the bytes already read from the input file,
+ * 		which are decoded first, or NULL
+ * @param
+ * prefix_size	the number of the bytes already read
+ * @param
+ * total_characters	the number of the decoded characters
+ * 			will be added to this variable
+ *
+ * @return	If the entire input file has been successfully read
+ * 		and decoded, this function returns zero.
+ * 		Otherwise, in case of any error,
+ * 		a positive error number is returned.
+ */
+static int ingest_read_loop (ingest_context *ic,
+		int fd,
+		decompressor *dc,
+		const char *prefix,
+		size_t prefix_size,
+		size_t *total_characters) {
+	char *input_buffer = NULL;
+	size_t input_buffer_size = ic->thread_count *
+		ingest_chunks_per_thread * ingest_chunk_size;
+	size_t chunk_count = (ic->thread_count == 1) ? 1 :
+		ic->thread_count * ingest_chunks_per_thread;
+	size_t bytes_read = 0;
+	size_t filled = 0;
+	size_t unused_input_bytes = 0;
+	int read_retval = 0;
+	int retval = 0;
+	try {
+		input_buffer = new char[input_buffer_size];
+		ic->chunks = new ingest_chunk[chunk_count];
+	} catch (std::bad_alloc &) {
+		std::cerr << "input_buffer allocation error!\n";
+		delete[] input_buffer;
+		return (1);
+	}
+	if ((prefix != NULL) && (prefix_size > 0)) {
+		memcpy(input_buffer, prefix, prefix_size);
+	} else {
+		prefix_size = 0;
+	}
+	/*
+	 * here, unused_input_bytes should be equal to 0
+	 * and the prefix is treated as the first bytes read
+	 */
+	while (retval == 0) {
+		if (dc != NULL) {
+			read_retval = dc->read(input_buffer +
+					unused_input_bytes + prefix_size,
+					input_buffer_size -
+					unused_input_bytes - prefix_size,
+					&bytes_read);
+		} else {
+			read_retval = text_file_read_buffer(fd,
+					input_buffer +
+					unused_input_bytes + prefix_size,
+					input_buffer_size -
+					unused_input_bytes - prefix_size,
+					&bytes_read);
+		}
+		if (read_retval > 0) {
+			std::cerr << "Could not read the input file!\n";
+			retval = 1;
+			break;
+		}
+		bytes_read += prefix_size;
+		prefix_size = 0;
+		filled = unused_input_bytes + bytes_read;
+		ic->total_bytes += bytes_read;
+		retval = ingest_buffer(ic, input_buffer, filled, chunk_count,
+				total_characters, &unused_input_bytes);
+		/*
+		 * An incomplete multi-byte sequence at the end
+		 * of the buffer is moved to its beginning
+		 * to be decoded in the next round.
+		 */
+		memmove(input_buffer, input_buffer + filled -
+				unused_input_bytes, unused_input_bytes);
+		if (read_retval != 0) {
+			break;
+		}
+	}
+	if ((retval == 0) && (unused_input_bytes != (size_t)(0))) {
+		std::cerr << "Error: The input file ends "
+			"with an incomplete character.\n";
+		retval = 1;
+	}
+	delete[] ic->chunks;
+	ic->chunks = NULL;
+	delete[] input_buffer;
+	return (retval);
+}
+
+/**
+ * A function which enlarges the buffer of the input pipe,
+ * so that its writer can get further ahead of the reader
+ * and each read returns more data. It is not an error
+ * if the buffer can not be enlarged, for example because
+ * of the system limit of the pipe buffer size.
+ *
+ * @param
+ * fd	the file descriptor of the input pipe
+ */
+static void enlarge_pipe (int fd) {
+#ifdef F_SETPIPE_SZ
+	int size = 0;
+	/* the first size accepted by the system is used */
+	for (size = ingest_pipe_size; size >= 65536; size /= 2) {
+		if (fcntl(fd, F_SETPIPE_SZ, size) != (-1)) {
+			break;
+		}
+	}
+#else
+	(void)(fd);
+#endif
+	/* resetting the errno */
+	errno = 0;
+}
+
+/**
+ * A function which detects whether the regular input file
+ * is compressed. The other kinds of files, which can not be read
+ * twice, are checked by the ingest_stream function instead.
+ *
+ * @param
+ * fd	the file descriptor of the input file
+ * @param
+ * input_stat	the stat of the input file
+ *
+ * @return	This function returns the compression format
+ * 		of the input file.
+ */
+static int input_compression (int fd, const struct stat &input_stat) {
+	unsigned char magic[8];
+	ssize_t pread_retval = 0;
+	if (!S_ISREG(input_stat.st_mode)) {
+		return (COMPRESSION_NONE);
+	}
+	pread_retval = pread(fd, magic, sizeof (magic), 0);
+	if (pread_retval <= 0) {
+		/* resetting the errno */
+		errno = 0;
+		return (COMPRESSION_NONE);
+	}
+	return (detect_compression(magic, (size_t)(pread_retval)));
+}
+
+/**
+ * A function which reads and decodes the input file,
+ * which can not be read twice, like a pipe or a terminal.
+ * Its first bytes are read in advance, so that a gzip-
+ * or xz-compressed input is detected by its magic bytes
+ * and decompressed on a separate thread. The bytes read
+ * in advance are then decoded or decompressed first.
+ *
+ * @param
+ * ic	the ingest_context shared by all the tasks
+ * @param
+ * fd	the file descriptor of the input file
+ * @param
+ * dc	the decompressor, which is started if the input is compressed
+ * @param
+ * total_characters	the number of the decoded characters
+ * 			will be added to this variable
+ *
+ * @return	If the entire input file has been successfully read
+ * 		and decoded, this function returns zero.
+ * 		Otherwise, in case of any error,
+ * 		a positive error number is returned.
+ */
+static int ingest_stream (ingest_context *ic,
+		int fd,
+		decompressor *dc,
+		size_t *total_characters) {
+	char magic[6];
+	size_t magic_size = 0;
+	int compression = COMPRESSION_NONE;
+	int retval = 0;
+	if (text_file_read_buffer(fd, magic, sizeof (magic),
+				&magic_size) > 0) {
+		std::cerr << "Could not read the input file!\n";
+		return (1);
+	}
+	compression = detect_compression((const unsigned char *)(magic),
+			magic_size);
+	if (compression == COMPRESSION_NONE) {
+		return (ingest_read_loop(ic, fd, NULL, magic, magic_size,
+					total_characters));
+	}
+	/* the decompressor runs on its own thread */
+	if ((retval = dc->start(fd, compression, magic, magic_size)) == 0) {
+		retval = ingest_read_loop(ic, fd, dc, NULL, 0,
+				total_characters);
+	}
+	if ((dc->finish() != 0) && (retval == 0)) {
+		retval = 1;
+	}
+	return (retval);
+}
+
+/* regular functions */
+
+/**
+ * A function which determines the class of the provided
+ * character encoding name. The comparison ignores the case,
+ * the dashes and the underscores, as well as any iconv suffixes
+ * like "//TRANSLIT".
+ *
+ * @param
+ * encoding	the name of the character encoding
+ *
+ * @return	This function returns one of the encoding_class values.
+ * 		The encodings with a byte order mark (BOM),
+ * 		like the plain "UTF-16", are classified
+ * 		as ENCODING_CLASS_OTHER, because their byte order
+ * 		is only known at the beginning of the input.
+ * 		The same is true for the stateful encodings,
+ * 		like the ISO-2022-JP or the UTF-7, because their
+ * 		shift state is only known from the preceding input.
+ */
+int classify_encoding (const char *encoding) {
+	std::string name = normalize_encoding_name(encoding);
+	if ((name == "UTF8") || (name == "UTF8MAC")) {
+		return (ENCODING_CLASS_UTF8);
+	} else if (name == "UTF16LE") {
+		return (ENCODING_CLASS_UTF16LE);
+	} else if (name == "UTF16BE") {
+		return (ENCODING_CLASS_UTF16BE);
+	} else if ((name == "UCS2LE") || (name == "UCS2BE")) {
+		return (ENCODING_CLASS_FIXED2);
+	} else if ((name == "UCS4LE") || (name == "UCS4BE") ||
+			(name == "UTF32LE") || (name == "UTF32BE")) {
+		return (ENCODING_CLASS_FIXED4);
+	} else if ((name == "ASCII") || (name == "USASCII") ||
+			(name == "ANSIX3.41968") ||
+			(name.compare(0, 7, "ISO8859") == 0) ||
+			(name.compare(0, 5, "LATIN") == 0) ||
+			(name.compare(0, 5, "CP125") == 0) ||
+			(name.compare(0, 10, "WINDOWS125") == 0) ||
+			(name.compare(0, 4, "KOI8") == 0)) {
+		return (ENCODING_CLASS_FIXED1);
+	} else if ((name.compare(0, 3, "EUC") == 0) ||
+			(name == "GB2312")) {
+		return (ENCODING_CLASS_EUC);
+	} else if ((name == "GB18030") || (name == "GBK") ||
+			(name == "CP936") ||
+			(name.compare(0, 8, "SHIFTJIS") == 0) ||
+			(name == "SJIS") || (name == "MSKANJI") ||
+			(name == "CP932") || (name == "WINDOWS31J") ||
+			(name.compare(0, 4, "BIG5") == 0) ||
+			(name == "CP950") || (name == "UHC") ||
+			(name == "CP949") || (name == "JOHAB") ||
+			(name == "CP1361")) {
+		return (ENCODING_CLASS_DBCS);
+	}
+	return (ENCODING_CLASS_OTHER);
+}
+
+/**
+ * A function which finds the first character boundary
+ * in the provided buffer at or after the specified position.
+ * The beginning of the buffer is supposed
+ * to be a character boundary.
+ *
+ * @param
+ * encoding_class	the class of the character encoding
+ * 			of the buffer
+ * @param
+ * buffer	the buffer of encoded characters
+ * @param
+ * buffer_size	the number of bytes in the buffer
+ * @param
+ * position	the position from which the boundary is searched for
+ *
+ * @return	This function returns the position of the first
+ * 		character boundary not preceding the specified position.
+ * 		If there is no such boundary, or if the boundaries
+ * 		can not be determined for the provided encoding class,
+ * 		the buffer_size is returned.
+ */
+size_t find_character_boundary (int encoding_class,
+		const char *buffer,
+		size_t buffer_size,
+		size_t position) {
+	const unsigned char *bytes = (const unsigned char *)(buffer);
+	size_t limit = 0;
+	if (position >= buffer_size) {
+		return (buffer_size);
+	}
+	switch (encoding_class) {
+		case ENCODING_CLASS_UTF8:
+			/* skipping at most three continuation bytes */
+			limit = position + 3;
+			while ((position < buffer_size) &&
+					(position < limit) &&
+					((bytes[position] & 0xC0) == 0x80)) {
+				++position;
+			}
+			break;
+		case ENCODING_CLASS_UTF16LE:
+		case ENCODING_CLASS_UTF16BE:
+			position += position % 2;
+			if (position + 1 >= buffer_size) {
+				return (buffer_size);
+			}
+			/* a low surrogate continues the previous character */
+			if ((bytes[position +
+				(encoding_class ==
+				 ENCODING_CLASS_UTF16LE ? 1 : 0)] &
+					0xFC) == 0xDC) {
+				position += 2;
+			}
+			break;
+		case ENCODING_CLASS_FIXED1:
+			break;
+		case ENCODING_CLASS_FIXED2:
+			position += position % 2;
+			break;
+		case ENCODING_CLASS_FIXED4:
+			position += (4 - position % 4) % 4;
+			break;
+		case ENCODING_CLASS_EUC:
+			/* resynchronizing at the next single-byte character */
+			while ((position < buffer_size) &&
+					(bytes[position] >= 0x80)) {
+				++position;
+			}
+			break;
+		case ENCODING_CLASS_DBCS:
+			/*
+			 * The trail bytes of these encodings can be
+			 * in the ASCII range, but never below 0x30,
+			 * so we resynchronize at the next control character,
+			 * space or punctuation below the digits.
+			 */
+			while ((position < buffer_size) &&
+					(bytes[position] >= 0x30)) {
+				++position;
+			}
+			break;
+		default:
+			return (buffer_size);
+	}
+	if (position > buffer_size) {
+		return (buffer_size);
+	}
+	return (position);
+}
+
+/**
+ * A function which decodes the provided buffer of encoded characters
+ * using the provided conversion descriptor and counts
+ * the occurrences of the decoded characters in the provided histogram.
+ * Unlike the convert_to_wbuffer function, it never modifies
+ * the input buffer, so it can also be used on the read-only memory.
+ *
+ * @param
+ * cd	the iconv conversion descriptor used for the character conversion
+ * @param
+ * input_buffer	the buffer of encoded characters
+ * @param
+ * input_buffer_size	the number of bytes in the input buffer
+ * @param
+ * wbuffer	the auxiliary buffer for the decoded wide characters
+ * @param
+ * wbuffer_size	the number of characters in the auxiliary buffer
+ * @param
+ * histogram	the histogram of character occurrences
+ * @param
+ * unused_input_bytes	when this function returns, this variable
+ * 			will be set to the number of bytes
+ * 			of the incomplete character at the end
+ * 			of the input buffer
+ * @param
+ * characters	the number of decoded characters
+ * 		will be added to this variable
+ *
+ * @return	If the entire input buffer has been successfully decoded,
+ * 		this function returns zero.
+ * 		If there was an incomplete multi-byte sequence
+ * 		at the end of the input buffer, this function returns (-1).
+ * 		Otherwise, in case of any error,
+ * 		a positive error number is returned.
+ */
+int decode_and_count (iconv_t *cd,
+		const char *input_buffer,
+		size_t input_buffer_size,
+		wchar_t *wbuffer,
+		size_t wbuffer_size,
+		character_histogram &histogram,
+		size_t *unused_input_bytes,
+		size_t *characters) {
+	/* the iconv does not modify the input, despite its prototype */
+	char *inbuf = const_cast<char *>(input_buffer);
+	char *outbuf = NULL;
+	size_t inbytesleft = input_buffer_size;
+	size_t outbytesleft = 0;
+	size_t decoded = 0;
+	size_t iconv_retval = 0;
+	(*unused_input_bytes) = 0;
+	while (inbytesleft > 0) {
+		outbuf = (char *)(wbuffer);
+		outbytesleft = wbuffer_size * sizeof (wchar_t);
+		iconv_retval = iconv((*cd), &inbuf, &inbytesleft,
+				&outbuf, &outbytesleft);
+		decoded = wbuffer_size - outbytesleft / sizeof (wchar_t);
+		histogram.add(wbuffer, decoded);
+		(*characters) += decoded;
+		if (iconv_retval != (size_t)(-1)) {
+			if (iconv_retval > 0) {
+				std::cerr << "decode_and_count: iconv "
+					"converted " << iconv_retval <<
+					" characters\n"
+					"in a nonreversible way!\n";
+				return (2); /* possible failure */
+			}
+			continue;
+		}
+		if (errno == E2BIG) {
+			/* the wbuffer is full, we simply continue */
+			errno = 0;
+		} else if (errno == EINVAL) {
+			/* an incomplete multi-byte sequence at the end */
+			(*unused_input_bytes) = inbytesleft;
+			errno = 0;
+			return (-1);
+		} else {
+			perror("decode_and_count: iconv");
+			/* resetting the errno */
+			errno = 0;
+			return (1);
+		}
+	}
+	return (0);
+}
+
+/**
+ * A function which reads the entire input file opened
+ * by the file descriptor 'fd', decodes its characters
+ * and counts their occurrences. The input is split into chunks
+ * at the character boundaries and the chunks are decoded and counted
+ * on several threads, each of them using its own conversion descriptor
+ * and histogram. The per-thread histograms are merged
+ * into the provided histogram at the end. If the character boundaries
+ * can not be determined for the input encoding, the input is decoded
+ * by a single thread. The common Unicode encodings and the ISO-8859-1
+ * are decoded by the built-in decoders, all the other encodings
+ * are decoded by the iconv.
+ *
+ * A regular file is memory-mapped and decoded directly
+ * from the mapping. Other files, like pipes, as well as the files
+ * which could not have been mapped, are read into a buffer.
+ * A gzip- or xz-compressed input file, or a pipe, is decompressed
+ * on a separate thread, while the previously decompressed buffer
+ * is being decoded.
+ *
+ * @param
+ * fd	the file descriptor of the input file
+ * @param
+ * input_encoding	the character encoding of the input file
+ * @param
+ * internal_character_encoding	the encoding of the wchar_t characters
+ * @param
+ * thread_count	the maximum number of threads to use
+ * @param
+ * histogram	the histogram to which the character occurrences
+ * 		will be added
+ * @param
+ * total_characters	the number of the decoded characters
+ * 			will be added to this variable
+ * @param
+ * total_bytes	if not NULL, the number of the bytes read
+ * 		from the input file will be added to this variable
+ *
+ * @return	If the entire input file has been successfully read
+ * 		and decoded, this function returns zero.
+ * 		Otherwise, in case of any error,
+ * 		a positive error number is returned.
+ */
+int ingest_corpus_fd (int fd,
+		const char *input_encoding,
+		const char *internal_character_encoding,
+		size_t thread_count,
+		character_histogram &histogram,
+		size_t *total_characters,
+		size_t *total_bytes) {
+	ingest_context ic;
+	decompressor dc;
+	struct stat input_stat;
+	int compression = COMPRESSION_NONE;
+	size_t opened = 0;
+	size_t i = 0;
+	int encoding_class = classify_encoding(input_encoding);
+	int retval = 0;
+	if ((encoding_class == ENCODING_CLASS_OTHER) || (thread_count < 1)) {
+		thread_count = 1;
+	}
+	ic.encoding_class = encoding_class;
+	ic.decoder = select_builtin_decoder(input_encoding);
+	ic.thread_count = thread_count;
+	ic.total_bytes = 0;
+	ic.reset_state = (encoding_class != ENCODING_CLASS_OTHER);
+	ic.cds = NULL;
+	ic.wbuffers = NULL;
+	ic.histograms = NULL;
+	ic.chunks = NULL;
+	try {
+		ic.cds = new iconv_t[thread_count];
+		ic.wbuffers = new wchar_t *[thread_count];
+		for (i = 0; i < thread_count; ++i) {
+			ic.wbuffers[i] = NULL;
+		}
+		ic.histograms = new character_histogram *[thread_count];
+		for (i = 0; i < thread_count; ++i) {
+			ic.histograms[i] = NULL;
+		}
+		for (i = 0; i < thread_count; ++i) {
+			ic.wbuffers[i] = new wchar_t[ingest_wbuffer_size];
+			if (i > 0) {
+				ic.histograms[i] = new character_histogram();
+			}
+		}
+		/* the worker zero counts directly into the result */
+		ic.histograms[0] = &histogram;
+	} catch (std::bad_alloc &) {
+		std::cerr << "wbuffer or histogram allocation error!\n";
+		retval = 1;
+	}
+	/* the iconv is only needed if there is no built-in decoder */
+	for (opened = 0; (retval == 0) && (opened < thread_count) &&
+			(ic.decoder == BUILTIN_DECODER_NONE); ++opened) {
+		if ((ic.cds[opened] = iconv_open(internal_character_encoding,
+					input_encoding)) == (iconv_t)(-1)) {
+			perror("iconv_open 2");
+			retval = 1;
+			break;
+		}
+	}
+	if (retval == 0) {
+		if (fstat(fd, &input_stat) == (-1)) {
+			perror("ingest_corpus_fd: fstat");
+			/* resetting the errno */
+			errno = 0;
+			retval = 1;
+		} else if (!S_ISREG(input_stat.st_mode)) {
+			if (S_ISFIFO(input_stat.st_mode)) {
+				enlarge_pipe(fd);
+			}
+			retval = ingest_stream(&ic, fd, &dc,
+					total_characters);
+		} else if ((compression = input_compression(fd,
+					input_stat)) != COMPRESSION_NONE) {
+			/* the decompressor runs on its own thread */
+			if ((retval = dc.start(fd, compression, NULL, 0)) ==
+					0) {
+				retval = ingest_read_loop(&ic, fd, &dc,
+						NULL, 0, total_characters);
+			}
+			if ((dc.finish() != 0) && (retval == 0)) {
+				retval = 1;
+			}
+		} else if (input_stat.st_size > 0) {
+			retval = ingest_mapped_file(&ic, fd,
+					(size_t)(input_stat.st_size),
+					total_characters);
+		} else {
+			/* there is nothing to map */
+			retval = (-1);
+		}
+		if (retval < 0) {
+			retval = ingest_read_loop(&ic, fd, NULL, NULL, 0,
+					total_characters);
+		}
+	}
+	for (i = 0; i < opened; ++i) {
+		if (iconv_close(ic.cds[i]) == (-1)) {
+			perror("iconv_close 2");
+			retval = 1;
+		}
+	}
+	if (ic.histograms != NULL) {
+		for (i = 1; i < thread_count; ++i) {
+			if (ic.histograms[i] != NULL) {
+				histogram.merge(*(ic.histograms[i]));
+				delete ic.histograms[i];
+			}
+		}
+	}
+	if (ic.wbuffers != NULL) {
+		for (i = 0; i < thread_count; ++i) {
+			delete[] ic.wbuffers[i];
+		}
+	}
+	delete[] ic.histograms;
+	delete[] ic.wbuffers;
+	delete[] ic.cds;
+	if (total_bytes != NULL) {
+		(*total_bytes) += ic.total_bytes;
+	}
+	return (retval);
+}
+
+/**
+ * A function which builds an approximate histogram of the input file
+ * from a random sample of its chunks. The chunks of 1 MiB, aligned
+ * to their size, are chosen uniformly without replacement and read
+ * by the pread in the order of their offsets.
+ *
+ * For each character, the half-width of the 95% confidence interval
+ * of its frequency is estimated. The sampled chunks are split
+ * into random groups and the variance of the frequency is estimated
+ * from the differences between the groups, so that the correlation
+ * of the characters within a chunk is taken into account.
+ * The finite population correction is applied as well, so the bounds
+ * shrink to zero as the sample approaches the entire file.
+ *
+ * @param
+ * fd	the file descriptor of the regular input file
+ * @param
+ * input_encoding	the character encoding of the input file
+ * @param
+ * internal_character_encoding	the encoding of the wchar_t characters
+ * @param
+ * thread_count	the maximum number of threads to use
+ * @param
+ * sample_size	the desired number of bytes to sample
+ * @param
+ * seed		the seed of the choice of the chunks, so that
+ * 		the same seed samples the same chunks
+ * @param
+ * histogram	the histogram to which the sampled character
+ * 		occurrences will be added
+ * @param
+ * total_characters	the number of the sampled characters
+ * 			will be added to this variable
+ * @param
+ * sampled_bytes	when this function returns, this variable
+ * 			will be set to the number of the decoded bytes
+ * @param
+ * half_widths	the half-widths of the confidence intervals
+ * 		of the character frequencies will be stored here
+ *
+ * @return	If the sample has been successfully read and decoded,
+ * 		this function returns zero.
+ * 		Otherwise, in case of any error,
+ * 		a positive error number is returned.
+ */
+int ingest_corpus_sample (int fd,
+		const char *input_encoding,
+		const char *internal_character_encoding,
+		size_t thread_count,
+		size_t sample_size,
+		unsigned int seed,
+		character_histogram &histogram,
+		size_t *total_characters,
+		size_t *sampled_bytes,
+		confidence_map &half_widths) {
+	sample_context sc;
+	struct stat input_stat;
+	CRandomMersenne prng((int)(seed));
+	std::set<size_t> chosen;
+	std::vector<size_t> offsets;
+	occurrences_map *group_maps = NULL;
+	occurrences_map combined;
+	occurrences_map::const_iterator found;
+	size_t total_chunks = 0;
+	size_t sample_chunks = 0;
+	size_t sampled_characters = 0;
+	size_t unsynchronized = 0;
+	size_t opened = 0;
+	size_t i = 0;
+	size_t j = 0;
+	uint64_t random_bits = 0;
+	double p = 0;
+	double mean_characters = 0;
+	double deviation = 0;
+	double variance = 0;
+	double t_quantile = 0;
+	double sampling_fraction = 0;
+	int retval = 0;
+	if (fstat(fd, &input_stat) == (-1)) {
+		perror("ingest_corpus_sample: fstat");
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	if ((!S_ISREG(input_stat.st_mode)) || (input_stat.st_size <= 0)) {
+		std::cerr << "The corpus can only be sampled "
+			"from a non-empty regular file!\n";
+		return (1);
+	}
+	if (input_compression(fd, input_stat) != COMPRESSION_NONE) {
+		std::cerr << "The " << compression_name(input_compression(fd,
+					input_stat)) << "-compressed corpus "
+			"can not be sampled!\n";
+		return (1);
+	}
+	sc.encoding_class = classify_encoding(input_encoding);
+	if (sc.encoding_class == ENCODING_CLASS_OTHER) {
+		std::cerr << "The corpus in the encoding '" <<
+			input_encoding << "' can not be sampled,\n"
+			"because its character boundaries "
+			"can not be determined!\n";
+		return (1);
+	}
+	sc.fd = fd;
+	sc.decoder = select_builtin_decoder(input_encoding);
+	sc.file_size = (size_t)(input_stat.st_size);
+	total_chunks = (sc.file_size + sample_chunk_size - 1) /
+		sample_chunk_size;
+	sample_chunks = (sample_size + sample_chunk_size - 1) /
+		sample_chunk_size;
+	if (sample_chunks < 1) {
+		sample_chunks = 1;
+	} else if (sample_chunks > total_chunks) {
+		sample_chunks = total_chunks;
+	}
+	/*
+	 * choosing the chunks uniformly without replacement
+	 * using the Floyd's algorithm
+	 */
+	for (j = total_chunks - sample_chunks; j < total_chunks; ++j) {
+		random_bits = ((uint64_t)(prng.BRandom()) << 32) |
+			prng.BRandom();
+		i = (size_t)(random_bits % (uint64_t)(j + 1));
+		if (chosen.insert(i).second == false) {
+			chosen.insert(j);
+		}
+	}
+	for (std::set<size_t>::const_iterator it = chosen.begin();
+			it != chosen.end(); ++it) {
+		offsets.push_back((*it) * sample_chunk_size);
+	}
+	sc.offsets = &(offsets[0]);
+	sc.chunk_count = offsets.size();
+	sc.group_count = (thread_count > sample_min_groups) ?
+		thread_count : sample_min_groups;
+	if (sc.group_count > sc.chunk_count) {
+		sc.group_count = sc.chunk_count;
+	}
+	sc.cds = NULL;
+	sc.buffers = NULL;
+	sc.wbuffers = NULL;
+	sc.histograms = NULL;
+	sc.characters = NULL;
+	sc.bytes = NULL;
+	sc.unsynchronized = NULL;
+	try {
+		sc.cds = new iconv_t[sc.group_count];
+		sc.characters = new size_t[sc.group_count];
+		sc.bytes = new size_t[sc.group_count];
+		sc.unsynchronized = new size_t[sc.group_count];
+		group_maps = new occurrences_map[sc.group_count];
+		sc.buffers = new char *[sc.group_count];
+		sc.wbuffers = new wchar_t *[sc.group_count];
+		sc.histograms = new character_histogram *[sc.group_count];
+		for (i = 0; i < sc.group_count; ++i) {
+			sc.buffers[i] = NULL;
+			sc.wbuffers[i] = NULL;
+			sc.histograms[i] = NULL;
+			sc.characters[i] = 0;
+			sc.bytes[i] = 0;
+			sc.unsynchronized[i] = 0;
+		}
+		for (i = 0; i < sc.group_count; ++i) {
+			sc.buffers[i] = new char[sample_chunk_size];
+			sc.wbuffers[i] = new wchar_t[ingest_wbuffer_size];
+			sc.histograms[i] = new character_histogram();
+		}
+	} catch (std::bad_alloc &) {
+		std::cerr << "sample buffer allocation error!\n";
+		retval = 1;
+	}
+	for (opened = 0; (retval == 0) && (opened < sc.group_count) &&
+			(sc.decoder == BUILTIN_DECODER_NONE); ++opened) {
+		if ((sc.cds[opened] = iconv_open(internal_character_encoding,
+					input_encoding)) == (iconv_t)(-1)) {
+			perror("iconv_open 2");
+			retval = 1;
+			break;
+		}
+	}
+	if ((retval == 0) && (run_parallel(sample_group_task, &sc,
+				sc.group_count, thread_count) != 0)) {
+		std::cerr << "Could not sample the input file!\n";
+		retval = 1;
+	}
+	if (retval == 0) {
+		(*sampled_bytes) = 0;
+		for (i = 0; i < sc.group_count; ++i) {
+			sc.histograms[i]->fold(group_maps[i]);
+			histogram.merge(*(sc.histograms[i]));
+			sampled_characters += sc.characters[i];
+			(*sampled_bytes) += sc.bytes[i];
+			unsynchronized += sc.unsynchronized[i];
+			for (occurrences_map::const_iterator it =
+					group_maps[i].begin();
+					it != group_maps[i].end(); ++it) {
+				combined[it->first] += it->second;
+			}
+		}
+		(*total_characters) += sampled_characters;
+		if ((sampled_characters == 0) && (unsynchronized > 0)) {
+			std::cerr << "The character boundaries "
+				"of the sampled chunks "
+				"can not be determined!\n";
+			retval = 1;
+		} else if (sampled_characters == 0) {
+			std::cerr << "The sample of the input file "
+				"does not contain any characters!\n";
+			retval = 1;
+		}
+	}
+	if (retval == 0) {
+		sampling_fraction = (double)(sc.chunk_count) /
+			(double)(total_chunks);
+		mean_characters = (double)(sampled_characters) /
+			(double)(sc.group_count);
+		if (sc.group_count > 1) {
+			t_quantile = (sc.group_count - 1 <= 30) ?
+				sample_t_quantiles[sc.group_count - 2] :
+				1.96;
+		} else {
+			t_quantile = 1.96;
+		}
+		for (occurrences_map::const_iterator it = combined.begin();
+				it != combined.end(); ++it) {
+			p = (double)(it->second) /
+				(double)(sampled_characters);
+			if (sc.group_count > 1) {
+				variance = 0;
+				for (i = 0; i < sc.group_count; ++i) {
+					found = group_maps[i].find(it->first);
+					deviation = ((found == group_maps[i].end()) ?
+						0 : (double)(found->second)) -
+						p * (double)(sc.characters[i]);
+					deviation /= mean_characters;
+					variance += deviation * deviation;
+				}
+				variance /= (double)(sc.group_count) *
+					(double)(sc.group_count - 1);
+			} else {
+				/* a single chunk, the binomial estimate */
+				variance = p * (1 - p) /
+					(double)(sampled_characters);
+			}
+			half_widths[it->first] = t_quantile *
+				sqrt(variance * (1 - sampling_fraction));
+		}
+	}
+	for (i = 0; i < opened; ++i) {
+		if (iconv_close(sc.cds[i]) == (-1)) {
+			perror("iconv_close 2");
+			retval = 1;
+		}
+	}
+	if (sc.histograms != NULL) {
+		for (i = 0; i < sc.group_count; ++i) {
+			delete sc.histograms[i];
+			delete[] sc.wbuffers[i];
+			delete[] sc.buffers[i];
+		}
+	}
+	delete[] sc.histograms;
+	delete[] sc.wbuffers;
+	delete[] sc.buffers;
+	delete[] group_maps;
+	delete[] sc.unsynchronized;
+	delete[] sc.bytes;
+	delete[] sc.characters;
+	delete[] sc.cds;
+	return (retval);
+}
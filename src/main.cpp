@@ -27,7 +27,18 @@
  * when generating the random strings.
  */
 #include "auxiliary.h"
+#include "cache.h"
+#include "corpus.h"
+#include "decoder.h"
+#include "distribution.h"
+#include "encoder.h"
+#include "follow.h"
+#include "ingest.h"
+#include "numa.h"
+#include "output.h"
+#include "parallel.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <climits>
 #include <cstdio>
@@ -35,10 +46,47 @@
 #include <cstring>
 #include <ctime>
 #include <fcntl.h>
+#include <fstream>
+#include <getopt.h>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <string>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <vector>
+
+/* a named alphabet of the --preset parameter */
+struct alphabet_preset {
+	const char *name;
+	const char *alphabet;
+};
+
+/* the occurrences read from the corpus files by a job of the manifest */
+struct corpus_scan {
+	occurrences_map occurrences;
+	size_t characters;
+};
+
+/* simple typedefs */
+
+/* the corpus scans by the input encoding and the corpus files */
+typedef std::map<std::string, corpus_scan> corpus_scan_map;
+
+/* the preset alphabets, terminated by the empty preset */
+static const alphabet_preset alphabet_presets[] = {
+	{"hex", "0123456789abcdef"},
+	{"base32", "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567"},
+	{"base64", "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+		"abcdefghijklmnopqrstuvwxyz0123456789+/"},
+	{"base64url", "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+		"abcdefghijklmnopqrstuvwxyz0123456789-_"},
+	{"alnum", "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+		"abcdefghijklmnopqrstuvwxyz"},
+	{"digits", "0123456789"},
+	{NULL, NULL}
+};
 
 /**
  * A function, which prints the short usage text for this program.
@@ -84,14 +132,89 @@ int print_help (const char *argv0) {
 		"\t\t\tusing the uniform distribution.\n"
 		"-f <ifname>\tThe output characters will be picked\n"
 		"\t\tfrom the input file 'ifname'\n"
-		"\t\tusing the uniform distribution.\n\n"
+		"\t\tusing the uniform distribution.\n"
+		"\t\tThe parameter -f can be repeated.\n"
+		"\t\tThe 'ifname' can also be a directory,\n"
+		"\t\twhich is searched recursively,\n"
+		"\t\tor a quoted glob pattern like 'texts/*.txt'.\n"
+		"\t\tThe 'ifname' - stands for the standard input.\n"
+		"\t\tA gzip- or xz-compressed input file,\n"
+		"\t\teven the one read from a pipe,\n"
+		"\t\tis decompressed.\n"
+		"\t\tAll the input files are read concurrently.\n"
+		"--preset <name>\tThe output characters will be picked\n"
+		"\t\tfrom the named alphabet\n"
+		"\t\tusing the uniform distribution.\n"
+		"\t\tThe available names are:\n"
+		"\t\thex\t0-9 a-f\n"
+		"\t\tbase32\tA-Z 2-7\n"
+		"\t\tbase64\tA-Z a-z 0-9 + /\n"
+		"\t\tbase64url\tA-Z a-z 0-9 - _\n"
+		"\t\talnum\t0-9 A-Z a-z\n"
+		"\t\tdigits\t0-9\n"
+		"--raw\t\tThe output will consist of the random bytes\n"
+		"\t\tof the pseudorandom number generator\n"
+		"\t\twithout any characters. The 'length'\n"
+		"\t\tis then the number of bytes.\n\n"
 		"Additional options:\n\n"
+		"-b <bytes>\tGenerates exactly the specified number\n"
+		"\t\tof bytes instead of the -l characters.\n"
+		"\t\tThe output encoding has to be stateless.\n"
+		"-j <threads>\tGenerates the blocks of the output\n"
+		"\t\ton the specified number of threads.\n"
+		"\t\tThe output does not depend on the number\n"
+		"\t\tof threads. By default, a single output file\n"
+		"\t\tof a given length is generated by one thread\n"
+		"\t\tand the others by all the processors.\n"
+		"\t\tIf every character of a regular output file\n"
+		"\t\tis encoded in the same number of bytes,\n"
+		"\t\tthe threads write the blocks directly\n"
+		"\t\tto their offsets.\n"
+		"--write-buffers <count>\tSpecifies the number\n"
+		"\t\t\tof the output buffers per generating thread.\n"
+		"\t\t\tA single output file is written\n"
+		"\t\t\tby a separate thread, so the blocks\n"
+		"\t\t\tare generated while the previous ones\n"
+		"\t\t\tare being written. The default value is 2.\n"
+		"--mmap\t\tGenerates the characters directly\n"
+		"\t\tinto the memory mapped output file.\n"
+		"\t\tEvery character has to be encoded\n"
+		"\t\tin the same number of bytes.\n"
+		"--numa\t\tPins the worker threads to the NUMA nodes\n"
+		"\t\tand the writer thread to the node\n"
+		"\t\tof the output device. The buffers are placed\n"
+		"\t\ton the nodes of the workers filling them.\n"
+		"\t\tThe achieved placement is reported.\n"
+		"--manifest <file>\tRuns the generation jobs\n"
+		"\t\t\tlisted in the file, one job per line,\n"
+		"\t\t\teach with the parameters described here.\n"
+		"\t\t\tThe input files and the encoder tables\n"
+		"\t\t\tare shared by the jobs using them.\n"
+		"\t\t\tThis must be the only parameter.\n"
+		"--shard <i>/<n>\tGenerates only the shard i\n"
+		"\t\t\tof the output file split into n shards\n"
+		"\t\t\tof nearly equal lengths, 0 <= i < n.\n"
+		"\t\t\tThe shards generated separately\n"
+		"\t\t\twith the same seed and options\n"
+		"\t\t\tconcatenate to the whole output file.\n"
+		"--range <start>:<length>\tGenerates only\n"
+		"\t\t\tthe specified number of characters\n"
+		"\t\t\tof the output file starting\n"
+		"\t\t\tat the character start, counted from 0.\n"
+		"\t\t\tBoth --shard and --range require --seed\n"
+		"\t\t\tand can not be combined\n"
+		"\t\t\twith --sample-corpus.\n"
+		"--seed <seed>\tSeeds the pseudorandom number generator\n"
+		"\t\tby the specified number instead of the time.\n"
+		"\t\tThe same seed and options generate\n"
+		"\t\tthe same output, except for the generator U.\n"
 		"-g <generator>\tSpecifies the desired pseudorandom\n"
 		"\t\tnumber generator (PRNG) to use.\n"
 		"\t\tThe available values are:\n"
 		"\t\tM\tMersenne twister\n"
 		"\t\tR\trandom() function\n"
 		"\t\tU\t/dev/urandom system file\n"
+		"\t\tS\tSIMD-oriented Fast Mersenne Twister\n"
 		"\t\tThe default PRNG is the Mersenne twister.\n"
 		"-i <file_encoding>\tSpecifies the character encoding\n"
 		"\t\t\tof either the input alphabet string\n"
@@ -104,6 +227,32 @@ int print_help (const char *argv0) {
 		"\t\t\tThe default value is UTF-8.\n"
 		"\t\t\tThe valid encodings are all those\n"
 		"\t\t\tsupported by the iconv.\n"
+		"-e <file_encoding>:<file>\tAdds the output file 'file'\n"
+		"\t\t\tin the specified character encoding.\n"
+		"\t\t\tThe parameter can be repeated.\n"
+		"\t\t\tAll the output files contain\n"
+		"\t\t\tthe same characters. The 'filename'\n"
+		"\t\t\tis then optional.\n"
+		"--sample-corpus <size>\tBuilds the distribution\n"
+		"\t\t\tfrom a random sample of the input file 'ifname'.\n"
+		"\t\t\tThe 'size' is either a fraction\n"
+		"\t\t\tof the input file containing a decimal point,\n"
+		"\t\t\tlike 0.01, or a number of bytes, optionally\n"
+		"\t\t\tfollowed by one of the suffixes K, M or G.\n"
+		"\t\t\tThe 95% confidence bounds of the estimated\n"
+		"\t\t\tcharacter frequencies are reported.\n"
+		"\t\t\tThe sampled chunks are chosen by the seed\n"
+		"\t\t\tof the --seed parameter.\n"
+		"--cache <directory>\tStores the distribution built\n"
+		"\t\t\tfrom the input files in a cache file\n"
+		"\t\t\tin the specified directory. The next run\n"
+		"\t\t\twith the same input files and encoding\n"
+		"\t\t\tuses the cached distribution\n"
+		"\t\t\tinstead of reading the input files.\n"
+		"--follow\tKeeps reading the characters appended\n"
+		"\t\tto the single regular input file 'ifname'\n"
+		"\t\twhile the output is being generated\n"
+		"\t\tand updates the distribution accordingly.\n"
 		"-v\t\tMakes the output more verbose.\n";
 	return (0);
 }
@@ -124,51 +273,251 @@ int print_usage (const char *argv0) {
 	return (0);
 }
 
+/**
+ * A function which parses the size of the corpus sample.
+ *
+ * @param
+ * argument	the argument of the --sample-corpus option
+ * @param
+ * sample_fraction	if the argument is a fraction of the input file,
+ * 			this variable will be set to it
+ * @param
+ * sample_bytes	if the argument is a number of bytes,
+ * 		this variable will be set to it
+ *
+ * @return	If the argument has been successfully parsed,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int parse_sample_size (const char *argument,
+		double *sample_fraction,
+		size_t *sample_bytes) {
+	char *endptr = NULL;
+	unsigned long bytes = 0;
+	errno = 0;
+	if (strchr(argument, '.') != NULL) {
+		(*sample_fraction) = strtod(argument, &endptr);
+		if (((*endptr) != '\0') || (errno != 0) ||
+				(!((*sample_fraction) > 0)) ||
+				((*sample_fraction) > 1)) {
+			return (1);
+		}
+		return (0);
+	}
+	bytes = strtoul(argument, &endptr, 0);
+	if ((endptr == argument) || (errno != 0)) {
+		return (1);
+	}
+	switch (*endptr) {
+		case 'G':
+			bytes <<= 10;
+			/* falls through */
+		case 'M':
+			bytes <<= 10;
+			/* falls through */
+		case 'K':
+			bytes <<= 10;
+			++endptr;
+			break;
+	}
+	if (((*endptr) != '\0') || (bytes == 0)) {
+		return (1);
+	}
+	(*sample_fraction) = 0;
+	(*sample_bytes) = (size_t)(bytes);
+	return (0);
+}
+
+/**
+ * A function which prints the utilisation of the worker threads
+ * of all the parallel runs so far.
+ *
+ * @return	This function always returns zero (0).
+ */
+int print_utilisation () {
+	parallel_statistics statistics[parallel_recorded_workers];
+	const size_t worker_count = parallel_utilisation(statistics,
+			parallel_recorded_workers);
+	double busy_fraction = 0;
+	if (worker_count == 0) {
+		return (0);
+	}
+	std::cout << "Worker utilisation:\n";
+	for (size_t i = 0; i < worker_count; ++i) {
+		busy_fraction = (statistics[i].available_seconds > 0) ?
+			statistics[i].busy_seconds /
+			statistics[i].available_seconds : 0;
+		std::cout << "Worker " << i << ": " <<
+			statistics[i].tasks << " tasks (" <<
+			statistics[i].stolen_tasks << " stolen), busy " <<
+			std::fixed << std::setprecision(3) <<
+			statistics[i].busy_seconds << " s of " <<
+			statistics[i].available_seconds << " s (" <<
+			std::setprecision(1) << busy_fraction * 100 <<
+			"%)\n";
+	}
+	return (0);
+}
+
 /* the main function */
 
 /**
- * The main function.
- * It executes the appropriate function to generate a file
- * containing the random characters of the desired kind.
+ * A function which generates the output file
+ * of the raw pseudorandom bytes.
+ *
+ * @param
+ * output_filename	the name of the output file
+ * @param
+ * output_length	the number of bytes to generate
+ * @param
+ * block_size	the number of bytes generated at once
+ *
+ * @return	If the output file has been successfully generated,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int generate_raw_file (const char *output_filename,
+		size_t output_length,
+		size_t block_size) {
+	char *output_buffer = NULL;
+	size_t bytes_left = output_length;
+	size_t block_bytes = 0;
+	int ofd = open(output_filename, O_WRONLY | O_CREAT | O_TRUNC,
+			S_IRUSR | S_IWUSR |
+			S_IRGRP | S_IWGRP |
+			S_IROTH | S_IWOTH);
+	if (ofd == -1) {
+		perror("output_filename: open");
+		return (1);
+	}
+	try {
+		output_buffer = new char[block_size];
+	} catch (std::bad_alloc &) {
+		std::cerr << "output_buffer allocation error!\n";
+		close(ofd);
+		return (1);
+	}
+	std::cout << "\nGenerating the raw random file '" <<
+		output_filename << "'\n";
+	for (; bytes_left > 0; bytes_left -= block_bytes) {
+		block_bytes = std::min(bytes_left, block_size);
+		if (fill_output_raw(output_buffer, block_bytes) != 0) {
+			break;
+		}
+		if (write(ofd, output_buffer, block_bytes) == (-1)) {
+			perror("output_filename: write");
+			break;
+		}
+	}
+	delete[] output_buffer;
+	if (close(ofd) == -1) {
+		perror("output_filename: close");
+		return (1);
+	}
+	if (bytes_left > 0) {
+		return (1);
+	}
+	std::cout << "Successfully written " << output_length <<
+		" bytes\n";
+	return (0);
+}
+
+/**
+ * A function which returns the key of the corpus scan
+ * of the corpus files in the input encoding.
+ *
+ * @param
+ * files	the corpus files
+ * @param
+ * input_encoding	the input character encoding
+ *
+ * @return	This function returns the key of the corpus scan,
+ * 		or an empty string if the corpus files can not be
+ * 		scanned again, like the standard input.
+ */
+std::string corpus_scan_key (const corpus_file_list &files,
+		const char *input_encoding) {
+	std::string key = input_encoding;
+	for (size_t i = 0; i < files.size(); ++i) {
+		if (files[i].path == corpus_standard_input) {
+			return (std::string());
+		}
+		key += '\0';
+		key += files[i].path;
+	}
+	return (key);
+}
+
+/**
+ * A function which generates a file containing the random characters
+ * of the kind described by the command line arguments.
  *
  * @param
  * argc		the argument count, or the number of program arguments
  * 		(including the argv[0])
  * @param
  * argv		the argument vector itself, or an array of argument strings
+ * @param
+ * scans	the corpus scans of the earlier jobs of the manifest,
+ * 		which are reused and extended by this job,
+ * 		or NULL outside of the manifest
  *
  * @return	If the file containing the random characters
  * 		of the desired kind has been successfully created,
  * 		this function returns EXIT_SUCCESS.
  * 		Otherwise, it returns EXIT_FAILURE.
  */
-int main (int argc, char **argv) {
+int generate (int argc, char **argv, corpus_scan_map *scans) {
 	size_t alphabet_size = 0;
-	size_t write_size = 0;
 	size_t write_count = 0;
 	size_t block_size = 8388608; /* 2^23 a.k.a. 8 Mi */
 	size_t input_buffer_size = 0;
-	size_t output_buffer_size = block_size;
 	size_t wbuffer_size = block_size;
 	size_t output_length = 0;
+	/* the exact number of bytes to generate, if nonzero */
+	size_t output_bytes = 0;
+	/* the range of the characters of the output file to generate */
+	size_t range_start = 0;
+	size_t range_length = 0;
+	/* the shard of the output file to generate, if the count is nonzero */
+	size_t shard_index = 0;
+	size_t shard_count = 0;
 	size_t characters_converted = 0;
 	size_t wchar_t_size = sizeof(wchar_t);
-	size_t bytes_to_write = 0;
-	size_t bytes_read = 0;
-	size_t cum_sum = 0;
-	size_t last_block_characters = 0;
+	/* the index of the block containing the first generated character */
+	size_t first_block = 0;
+	/* the index of the current block */
+	size_t block = 0;
+	/* the first generated character of the current block */
+	size_t block_start = 0;
+	/* the number of characters of the current block */
+	size_t block_characters = 0;
+	/* the number of generating threads, zero if not specified */
+	size_t thread_count = 0;
+	/* the number of output buffers per generating thread */
+	size_t write_buffers = 2;
+	/* the number of threads decoding the input file */
+	size_t ingest_thread_count = available_processors();
 	size_t total_input_characters = 0;
-	size_t total_bytes_written = 0;
+	/*
+	 * the number of bytes of the input file to sample,
+	 * zero if the entire input file should be read
+	 */
+	size_t sample_bytes = 0;
+	size_t sampled_bytes = 0;
+	/* the number of bytes of the followed input file read so far */
+	size_t follow_offset = 0;
 	/*
 	 * number of bytes unused in the last call
 	 * to the convert_to_wbuffer function
 	 */
 	size_t unused_input_bytes = 0;
-	char c = '\0';
 	char *endptr = NULL;
 	char *input_buffer = NULL;
-	char *output_buffer = NULL;
-	const char *input_filename = NULL;
+	/* the input file arguments of the -f parameters */
+	std::vector<const char *> input_arguments;
+	/* the corpus files the input file arguments expand to */
+	corpus_file_list input_files;
 	const char *input_encoding = "UTF-8";
 	/*
 	 * character encoding used in the internal text representation,
@@ -177,39 +526,121 @@ int main (int argc, char **argv) {
 	const char *internal_character_encoding = NULL;
 	const char *output_file_encoding = "UTF-8";
 	const char *output_filename = NULL;
+	/* the alphabet of the --preset parameter */
+	const char *preset_alphabet = NULL;
+	/* the directory of the distribution cache files, if any */
+	const char *cache_directory = NULL;
+	/* the path of the cache file of the input files */
+	std::string cache_path;
+	/* the key of the corpus scan, if it can be reused */
+	std::string scan_key;
+	corpus_scan_map::const_iterator scan;
 	wchar_t *wbuffer = NULL;
-	wchar_t *output_wbuffer = NULL;
-	int ifd = 0;
-	int ofd = 0;
+	int ifd = (-1);
+	struct stat input_stat;
 	/* The default pseudorandom number generator is the Mersenne twister. */
 	int prng_type = 1;
 	/* indicates whether or not we should be verbose */
 	int verbose_flag = 0;
 	int distribution_specification_type = 0;
-	int retval = 0;
 	int getopt_retval = 0;
+	/* indicates whether the distribution has been read from the cache */
+	int cache_hit = 0;
+	/* indicates whether the corpus scan of an earlier job is reused */
+	int scan_hit = 0;
+	int cache_retval = 0;
+	int output_specification_retval = 0;
+	int positioned_retval = 0;
+	/* indicates whether the input file should be followed */
+	int follow_flag = 0;
+	/* indicates whether the threads should be pinned to the NUMA nodes */
+	int numa_flag = 0;
+	/* indicates whether the output file should be memory mapped */
+	int mmap_flag = 0;
+	/* indicates whether the seed has been specified */
+	int seed_flag = 0;
+	/* indicates whether only a range of the output file is generated */
+	int range_flag = 0;
+	/* indicates whether the raw random bytes should be output */
+	int raw_flag = 0;
 	double scale_factor = 0;
+	/* the seed of the pseudorandom number generator */
+	unsigned long seed = (unsigned long)(time(NULL));
+	/* the fraction of the input file to sample */
+	double sample_fraction = 0;
 	unsigned int i = 0;
+	size_t j = 0;
 	/* the conversion descriptor used by the iconv */
 	iconv_t cd = NULL; /* iconv_t is just a typedef for void* */
+	/* a histogram of character occurrences in the input */
+	character_histogram histogram;
 	/* a std::map<wchar_t, size_t> of character occurrences */
 	occurrences_map occurrences;
 	/*
-	 * the "probability map" used to determine the character,
+	 * the distribution used to determine the character,
 	 * which will be output according to the probability
 	 * of its occurrences in the input text
 	 */
-	probability_map pmap;
+	distribution dist;
+	/* the distribution used to generate the current block */
+	const distribution *block_dist = &dist;
+	/* the follower of the growing input file */
+	corpus_follower follower;
+	/* the names and encodings of the output files */
+	std::vector<std::string> output_filenames;
+	std::vector<std::string> output_encodings;
+	std::string output_encoding_argument;
+	std::string output_filename_argument;
+	/* the opened output files */
+	output_target_list output_targets;
+	/* the encoder of the output file of --mmap, checked before opening */
+	symbol_encoder mmap_encoder;
+	/* the indices of the symbols sampled for all the output files */
+	uint32_t *output_indices = NULL;
+	/* the confidence bounds of the sampled character frequencies */
+	confidence_map half_widths;
+	/* the values returned by the getopt_long for the long options */
+	enum {
+		OPTION_SAMPLE_CORPUS = 256,
+		OPTION_CACHE,
+		OPTION_FOLLOW,
+		OPTION_PRESET,
+		OPTION_RAW,
+		OPTION_SEED,
+		OPTION_WRITE_BUFFERS,
+		OPTION_MMAP,
+		OPTION_NUMA,
+		OPTION_MANIFEST,
+		OPTION_SHARD,
+		OPTION_RANGE
+	};
+	/* the long options */
+	static const struct option long_options[] = {
+		{"sample-corpus", required_argument, NULL,
+			OPTION_SAMPLE_CORPUS},
+		{"cache", required_argument, NULL, OPTION_CACHE},
+		{"follow", no_argument, NULL, OPTION_FOLLOW},
+		{"preset", required_argument, NULL, OPTION_PRESET},
+		{"raw", no_argument, NULL, OPTION_RAW},
+		{"seed", required_argument, NULL, OPTION_SEED},
+		{"write-buffers", required_argument, NULL,
+			OPTION_WRITE_BUFFERS},
+		{"mmap", no_argument, NULL, OPTION_MMAP},
+		{"numa", no_argument, NULL, OPTION_NUMA},
+		{"manifest", required_argument, NULL, OPTION_MANIFEST},
+		{"shard", required_argument, NULL, OPTION_SHARD},
+		{"range", required_argument, NULL, OPTION_RANGE},
+		{NULL, 0, NULL, 0}
+	};
 	/* parsing the command line options */
-	while ((getopt_retval = getopt(argc, argv, "a:s:f:l:g:i:e:vh")) !=
-			(-1)) {
-		c = (char)(getopt_retval);
-		switch (c) {
+	while ((getopt_retval = getopt_long(argc, argv, "a:s:f:l:b:j:g:i:e:vh",
+					long_options, NULL)) != (-1)) {
+		switch (getopt_retval) {
 			case 'a':
 				if (distribution_specification_type != 0) {
 					std::cerr << "You can only specify "
 						"one of the parameters "
-						"-a -s or -f.\n\n";
+						"-a, -s, -f or --preset.\n\n";
 					return (EXIT_FAILURE);
 				}
 				distribution_specification_type = 1;
@@ -220,7 +651,7 @@ int main (int argc, char **argv) {
 				if (distribution_specification_type != 0) {
 					std::cerr << "You can only specify "
 						"one of the parameters "
-						"-a -s or -f.\n\n";
+						"-a, -s, -f or --preset.\n\n";
 					return (EXIT_FAILURE);
 				}
 				distribution_specification_type = 2;
@@ -237,14 +668,15 @@ int main (int argc, char **argv) {
 				}
 				break;
 			case 'f':
-				if (distribution_specification_type != 0) {
+				if ((distribution_specification_type != 0) &&
+					(distribution_specification_type != 3)) {
 					std::cerr << "You can only specify "
 						"one of the parameters "
-						"-a -s or -f.\n\n";
+						"-a, -s, -f or --preset.\n\n";
 					return (EXIT_FAILURE);
 				}
 				distribution_specification_type = 3;
-				input_filename = optarg;
+				input_arguments.push_back(optarg);
 				break;
 			case 'l':
 				output_length = strtoul(optarg, &endptr, 0);
@@ -259,6 +691,32 @@ int main (int argc, char **argv) {
 					return (EXIT_FAILURE);
 				}
 				break;
+			case 'b':
+				output_bytes = strtoul(optarg, &endptr, 0);
+				if ((*endptr) != '\0') {
+					std::cerr << "Unrecognized "
+						"argument for the -b "
+						"parameter!\n\n";
+					return (EXIT_FAILURE);
+				}
+				if (errno != 0) {
+					perror("strtoul(output_bytes)");
+					return (EXIT_FAILURE);
+				}
+				break;
+			case 'j':
+				thread_count = strtoul(optarg, &endptr, 0);
+				if (((*endptr) != '\0') || (thread_count == 0)) {
+					std::cerr << "Unrecognized "
+						"argument for the -j "
+						"parameter!\n\n";
+					return (EXIT_FAILURE);
+				}
+				if (errno != 0) {
+					perror("strtoul(thread_count)");
+					return (EXIT_FAILURE);
+				}
+				break;
 			case 'g':
 				if (optarg[0] == 'M') {
 					prng_type = 1;
@@ -266,6 +724,8 @@ int main (int argc, char **argv) {
 					prng_type = 2;
 				} else if (optarg[0] == 'U') {
 					prng_type = 3;
+				} else if (optarg[0] == 'S') {
+					prng_type = 4;
 				} else {
 					std::cerr << "Unrecognized "
 						"argument for the -g "
@@ -277,11 +737,164 @@ int main (int argc, char **argv) {
 				input_encoding = optarg;
 				break;
 			case 'e':
-				output_file_encoding = optarg;
+				output_specification_retval =
+					parse_output_specification(optarg,
+						output_encoding_argument,
+						output_filename_argument);
+				if (output_specification_retval < 0) {
+					output_file_encoding = optarg;
+				} else if (output_specification_retval > 0) {
+					std::cerr << "Unrecognized "
+						"argument for the -e "
+						"parameter!\n\n";
+					return (EXIT_FAILURE);
+				} else {
+					output_encodings.push_back(
+						output_encoding_argument);
+					output_filenames.push_back(
+						output_filename_argument);
+				}
 				break;
 			case 'v':
 				verbose_flag = 1;
 				break;
+			case OPTION_SAMPLE_CORPUS:
+				if (parse_sample_size(optarg, &sample_fraction,
+							&sample_bytes) != 0) {
+					std::cerr << "Unrecognized "
+						"argument for the "
+						"--sample-corpus "
+						"parameter!\n\n";
+					return (EXIT_FAILURE);
+				}
+				break;
+			case OPTION_CACHE:
+				cache_directory = optarg;
+				break;
+			case OPTION_FOLLOW:
+				follow_flag = 1;
+				break;
+			case OPTION_RAW:
+				raw_flag = 1;
+				break;
+			case OPTION_MMAP:
+				mmap_flag = 1;
+				break;
+			case OPTION_NUMA:
+				numa_flag = 1;
+				break;
+			case OPTION_MANIFEST:
+				std::cerr << "The parameter --manifest "
+					"can not be combined\n"
+					"with any other parameters!\n\n";
+				return (EXIT_FAILURE);
+			case OPTION_WRITE_BUFFERS:
+				write_buffers = strtoul(optarg, &endptr, 0);
+				if (((*endptr) != '\0') ||
+						(write_buffers < 2)) {
+					std::cerr << "Unrecognized "
+						"argument for the "
+						"--write-buffers "
+						"parameter!\n\n";
+					return (EXIT_FAILURE);
+				}
+				if (errno != 0) {
+					perror("strtoul(write_buffers)");
+					return (EXIT_FAILURE);
+				}
+				break;
+			case OPTION_SEED:
+				seed = strtoul(optarg, &endptr, 0);
+				if ((*endptr) != '\0') {
+					std::cerr << "Unrecognized "
+						"argument for the --seed "
+						"parameter!\n\n";
+					return (EXIT_FAILURE);
+				}
+				if (errno != 0) {
+					perror("strtoul(seed)");
+					return (EXIT_FAILURE);
+				}
+				seed_flag = 1;
+				break;
+			case OPTION_SHARD:
+				if (range_flag != 0) {
+					std::cerr << "You can only specify "
+						"one of the parameters "
+						"--shard or --range.\n\n";
+					return (EXIT_FAILURE);
+				}
+				shard_index = strtoul(optarg, &endptr, 10);
+				if ((*endptr) == '/') {
+					shard_count = strtoul(endptr + 1,
+							&endptr, 10);
+				}
+				if (((*endptr) != '\0') ||
+						(shard_index >= shard_count)) {
+					std::cerr << "Unrecognized "
+						"argument for the --shard "
+						"parameter!\n\n";
+					return (EXIT_FAILURE);
+				}
+				if (errno != 0) {
+					perror("strtoul(shard)");
+					return (EXIT_FAILURE);
+				}
+				range_flag = 1;
+				break;
+			case OPTION_RANGE:
+				if (range_flag != 0) {
+					std::cerr << "You can only specify "
+						"one of the parameters "
+						"--shard or --range.\n\n";
+					return (EXIT_FAILURE);
+				}
+				range_start = strtoul(optarg, &endptr, 0);
+				if ((*endptr) == ':') {
+					range_length = strtoul(endptr + 1,
+							&endptr, 0);
+				} else {
+					/* making the argument unrecognized */
+					endptr = optarg;
+				}
+				if (((*endptr) != '\0') ||
+						(endptr == optarg)) {
+					std::cerr << "Unrecognized "
+						"argument for the --range "
+						"parameter!\n\n";
+					return (EXIT_FAILURE);
+				}
+				if (errno != 0) {
+					perror("strtoul(range)");
+					return (EXIT_FAILURE);
+				}
+				range_flag = 1;
+				break;
+			case OPTION_PRESET:
+				if (distribution_specification_type != 0) {
+					std::cerr << "You can only specify "
+						"one of the parameters "
+						"-a, -s, -f or --preset.\n\n";
+					return (EXIT_FAILURE);
+				}
+				distribution_specification_type = 4;
+				for (i = 0; alphabet_presets[i].name != NULL;
+						++i) {
+					if (strcmp(alphabet_presets[i].name,
+							optarg) == 0) {
+						preset_alphabet =
+							alphabet_presets[i].
+							alphabet;
+						break;
+					}
+				}
+				if (preset_alphabet == NULL) {
+					std::cerr << "Unrecognized "
+						"argument for the --preset "
+						"parameter!\n\n";
+					return (EXIT_FAILURE);
+				}
+				break;
 			case 'h':
 				print_help(argv[0]);
 				return (EXIT_SUCCESS);
@@ -289,8 +902,15 @@ int main (int argc, char **argv) {
 				return (EXIT_FAILURE);
 		}
 	}
-	if (distribution_specification_type == 0) {
-		std::cerr << "At least one of the parameters -a, -s or -f\n"
+	if ((raw_flag != 0) && (distribution_specification_type != 0)) {
+		std::cerr << "The parameter --raw can not be combined\n"
+			"with the parameters -a, -s, -f or --preset!\n\n";
+		print_usage(argv[0]);
+		return (EXIT_FAILURE);
+	}
+	if ((distribution_specification_type == 0) && (raw_flag == 0)) {
+		std::cerr << "At least one of the parameters -a, -s, -f "
+			"or --preset\n"
 			"describing the probability distribution "
 			"must be specified!\n\n";
 		print_usage(argv[0]);
@@ -311,18 +931,145 @@ int main (int argc, char **argv) {
 			return (EXIT_FAILURE);
 		}
 	}
-	if (output_length == 0) {
+	if (((sample_fraction > 0) || (sample_bytes > 0)) &&
+			(distribution_specification_type != 3)) {
+		std::cerr << "The parameter --sample-corpus "
+			"requires the parameter -f!\n\n";
+		print_usage(argv[0]);
+		return (EXIT_FAILURE);
+	}
+	if ((cache_directory != NULL) &&
+			(distribution_specification_type != 3)) {
+		std::cerr << "The parameter --cache "
+			"requires the parameter -f!\n\n";
+		print_usage(argv[0]);
+		return (EXIT_FAILURE);
+	}
+	if ((follow_flag != 0) &&
+			(distribution_specification_type != 3)) {
+		std::cerr << "The parameter --follow "
+			"requires the parameter -f!\n\n";
+		print_usage(argv[0]);
+		return (EXIT_FAILURE);
+	}
+	if ((follow_flag != 0) && ((cache_directory != NULL) ||
+				(sample_fraction > 0) || (sample_bytes > 0))) {
+		std::cerr << "The parameter --follow can not be combined\n"
+			"with the parameters --cache "
+			"or --sample-corpus!\n\n";
+		print_usage(argv[0]);
+		return (EXIT_FAILURE);
+	}
+	if ((output_length != 0) && (output_bytes != 0)) {
+		std::cerr << "You can only specify "
+			"one of the parameters -l or -b.\n\n";
+		print_usage(argv[0]);
+		return (EXIT_FAILURE);
+	}
+	/* the length of the raw output is a number of bytes anyway */
+	if ((raw_flag != 0) && (output_bytes != 0)) {
+		output_length = output_bytes;
+		output_bytes = 0;
+	}
+	if ((output_length == 0) && (output_bytes == 0)) {
 		std::cerr << "The parameter -l is mandatory\n"
 			"and it ought to be positive!\n\n";
 		print_usage(argv[0]);
 		return (EXIT_FAILURE);
 	}
-	if (optind == argc) {
+	if ((output_bytes != 0) &&
+			((follow_flag != 0) || (!output_filenames.empty()))) {
+		std::cerr << "The parameter -b can not be combined\n"
+			"with the parameter --follow "
+			"or with several output files!\n\n";
+		print_usage(argv[0]);
+		return (EXIT_FAILURE);
+	}
+	/* the random() function has a single state shared by all the threads */
+	if ((thread_count > 1) && (prng_type == 2)) {
+		std::cerr << "The parameter -j can not be combined\n"
+			"with the random() function generator!\n\n";
+		print_usage(argv[0]);
+		return (EXIT_FAILURE);
+	}
+	/*
+	 * the modes running on all the processors by default
+	 * have to use a single thread for the random() function, too
+	 */
+	if (prng_type == 2) {
+		thread_count = 1;
+	}
+	/* the followed distribution is acquired before every block */
+	if ((thread_count > 1) && (follow_flag != 0)) {
+		std::cerr << "The parameter -j can not be combined\n"
+			"with the parameter --follow!\n\n";
+		print_usage(argv[0]);
+		return (EXIT_FAILURE);
+	}
+	if ((mmap_flag != 0) && ((output_bytes != 0) || (follow_flag != 0) ||
+				(raw_flag != 0) || (!output_filenames.empty()))) {
+		std::cerr << "The parameter --mmap can not be combined\n"
+			"with the parameters -b, --follow, --raw\n"
+			"or with several output files!\n\n";
+		print_usage(argv[0]);
+		return (EXIT_FAILURE);
+	}
+	/* the sampled distribution might differ from one machine to another */
+	if ((range_flag != 0) && ((output_bytes != 0) ||
+				(follow_flag != 0) || (raw_flag != 0) ||
+				(mmap_flag != 0) || (sample_fraction > 0) ||
+				(sample_bytes > 0))) {
+		std::cerr << "The parameters --shard and --range "
+			"can not be combined\n"
+			"with the parameters -b, --follow, --raw, --mmap\n"
+			"or --sample-corpus!\n\n";
+		print_usage(argv[0]);
+		return (EXIT_FAILURE);
+	}
+	/* the slices generated separately only match for the same seed */
+	if ((range_flag != 0) && ((seed_flag == 0) || (prng_type == 3))) {
+		std::cerr << "The parameters --shard and --range "
+			"require the parameter --seed\n"
+			"and a generator other than "
+			"the /dev/urandom system file!\n\n";
+		print_usage(argv[0]);
+		return (EXIT_FAILURE);
+	}
+	/* the shards split the output file as evenly as possible */
+	if (shard_count != 0) {
+		range_start = output_length / shard_count * shard_index +
+			output_length % shard_count * shard_index /
+			shard_count;
+		range_length = output_length / shard_count *
+			(shard_index + 1) + output_length % shard_count *
+			(shard_index + 1) / shard_count - range_start;
+	} else if (range_flag == 0) {
+		range_length = output_length;
+	}
+	if ((range_length > output_length) ||
+			(range_start > output_length - range_length)) {
+		std::cerr << "The range of the parameter --range "
+			"exceeds the length\n"
+			"of the output file!\n\n";
+		print_usage(argv[0]);
+		return (EXIT_FAILURE);
+	}
+	/* the output files of the -e parameters make the filename optional */
+	if ((optind == argc) &&
+			((output_filenames.empty()) || (raw_flag != 0))) {
 		std::cerr << "Missing the 'filename' parameter!\n\n";
 		print_usage(argv[0]);
 		return (EXIT_FAILURE);
 	}
-	output_filename = argv[optind];
+	if ((raw_flag != 0) && (!output_filenames.empty())) {
+		std::cerr << "The parameter --raw can not be combined\n"
+			"with the output files of the parameter -e!\n\n";
+		print_usage(argv[0]);
+		return (EXIT_FAILURE);
+	}
+	if (optind < argc) {
+		output_filename = argv[optind];
+	}
 	if (optind + 1 < argc) {
 		std::cerr << "Too many parameters!\n\n";
 		print_usage(argv[0]);
@@ -368,6 +1115,10 @@ int main (int argc, char **argv) {
 			case 3 : /* the /dev/urandom system file */
 				std::cout << "/dev/urandom system file\n";
 				break;
+			case 4 : /* SIMD-oriented Fast Mersenne Twister */
+				std::cout << "SIMD-oriented Fast "
+					"Mersenne Twister\n";
+				break;
 			default:
 				std::cout << "unknown (prng_type == " <<
 					prng_type << ")\n";
@@ -379,6 +1130,21 @@ int main (int argc, char **argv) {
 		std::cout << "Size of wchar_t data type: " <<
 			wchar_t_size << " bytes\n";
 	}
+	rsgen::set_seed((unsigned int)(seed));
+	if (numa_flag != 0) {
+		if (numa_enable_placement() != 0) {
+			return (EXIT_FAILURE);
+		}
+		print_numa_topology();
+	} else {
+		numa_disable_placement();
+	}
+	if (raw_flag != 0) {
+		rsgen::instance(prng_type);
+		return ((generate_raw_file(output_filename, output_length,
+					block_size) == 0) ?
+				EXIT_SUCCESS : EXIT_FAILURE);
+	}
 	/* if the user supplied the alphabet string */
 	if (distribution_specification_type == 1) {
 		std::cout << "Reading the input alphabet.\n";
@@ -402,7 +1168,7 @@ int main (int argc, char **argv) {
 			std::cerr << "Character conversion error!\n";
 			return (EXIT_FAILURE);
 		}
-		if (add_character_occurrences(occurrences,
+		if (add_character_occurrences(histogram,
 					wbuffer, characters_converted) > 0) {
 			std::cerr << "Could not determine the numbers of "
 				"occurrences\nof the individual characters!\n";
@@ -431,7 +1197,7 @@ int main (int argc, char **argv) {
 		for (i = 0; i < alphabet_size; ++i) {
 			wbuffer[i] = (wchar_t)(0x0100 + i);
 		}
-		if (add_character_occurrences(occurrences,
+		if (add_character_occurrences(histogram,
 					wbuffer, alphabet_size) > 0) {
 			std::cerr << "Could not determine the numbers of "
 				"occurrences\nof the individual characters!\n";
@@ -440,188 +1206,632 @@ int main (int argc, char **argv) {
 		total_input_characters = alphabet_size;
 		std::cout << "The input alphabet has been "
 			"successfully generated!\n";
+	/* if the user supplied the name of the preset alphabet */
+	} else if (distribution_specification_type == 4) {
+		std::cout << "Using the preset alphabet '" <<
+			preset_alphabet << "'.\n";
+		alphabet_size = strlen(preset_alphabet);
+		try {
+			wbuffer = new wchar_t[alphabet_size];
+		} catch (std::bad_alloc &) {
+			std::cerr << "wbuffer allocation error!\n";
+			return (EXIT_FAILURE);
+		}
+		/* the preset alphabets are made of ASCII characters only */
+		for (i = 0; i < alphabet_size; ++i) {
+			wbuffer[i] = (wchar_t)(preset_alphabet[i]);
+		}
+		if (add_character_occurrences(histogram,
+					wbuffer, alphabet_size) > 0) {
+			std::cerr << "Could not determine the numbers of "
+				"occurrences\nof the individual characters!\n";
+			return (EXIT_FAILURE);
+		}
+		total_input_characters = alphabet_size;
 	/* if the user supplied the name of the input file */
 	} else if (distribution_specification_type == 3) {
-		std::cout << "Reading the input file '" <<
-			input_filename << "'.\n";
-		/* we try to open the input file for reading */
-		ifd = open(input_filename, O_RDONLY);
-		if (ifd == (-1)) {
-			perror("input_filename: open");
+		if (expand_corpus_paths(input_arguments, input_files) != 0) {
 			return (EXIT_FAILURE);
 		}
-		/* we create the desired conversion descriptor */
-		if ((cd = iconv_open(internal_character_encoding,
-					input_encoding)) == (iconv_t)(-1)) {
-			perror("iconv_open 2");
+		if ((follow_flag != 0) && ((input_files.size() != 1) ||
+					(input_files[0].path ==
+					 corpus_standard_input))) {
+			std::cerr << "The parameter --follow requires "
+				"a single regular input file!\n";
 			return (EXIT_FAILURE);
 		}
-		input_buffer_size = block_size;
-		try {
-			input_buffer = new char[input_buffer_size];
-			wbuffer = new wchar_t[input_buffer_size];
-		} catch (std::bad_alloc &) {
-			std::cerr << "input_buffer or wbuffer "
-				"allocation error!\n";
-			return (EXIT_FAILURE);
+		if ((input_files.size() == 1) && (input_files[0].path ==
+					corpus_standard_input)) {
+			std::cout << "Reading the standard input.\n";
+		} else if (input_files.size() == 1) {
+			std::cout << "Reading the input file '" <<
+				input_files[0].path << "'.\n";
+		} else {
+			std::cout << "Reading " << input_files.size() <<
+				" input files.\n";
 		}
-		/* here, total_input_characters should be equal to 0 */
-		do {
-			if ((retval = text_file_read_buffer(ifd,
-					input_buffer + unused_input_bytes,
-					input_buffer_size - unused_input_bytes,
-					&bytes_read)) > 0) {
-				std::cerr <<
-					"Could not read the input file!\n";
+		/* the corpus files read by an earlier job are not read again */
+		if ((scans != NULL) && (follow_flag == 0) &&
+				(cache_directory == NULL) &&
+				(sample_fraction == 0) && (sample_bytes == 0)) {
+			scan_key = corpus_scan_key(input_files,
+					input_encoding);
+		}
+		if ((!scan_key.empty()) &&
+				((scan = scans->find(scan_key)) !=
+				 scans->end())) {
+			occurrences = scan->second.occurrences;
+			total_input_characters = scan->second.characters;
+			scan_hit = 1;
+		}
+		if (verbose_flag != 0) {
+			std::cout << "Corpus ingest threads: " <<
+				ingest_thread_count << "\n";
+			std::cout << "Corpus decoder: " <<
+				((select_builtin_decoder(input_encoding) !=
+				  BUILTIN_DECODER_NONE) ?
+				 "built-in" : "iconv") << "\n";
+		}
+		if (cache_directory != NULL) {
+			cache_retval = distribution_cache_path(cache_directory,
+					input_files, input_encoding,
+					cache_path);
+			if (cache_retval > 0) {
 				return (EXIT_FAILURE);
+			} else if (cache_retval < 0) {
+				std::clog << "Warning: The input can not "
+					"be cached, because it is not\n"
+					"made of regular files only.\n";
+				cache_path.clear();
+			} else if (load_distribution_cache(cache_path,
+					input_files, input_encoding,
+					ingest_thread_count, dist) == 0) {
+				cache_hit = 1;
+				total_input_characters =
+					(size_t)(dist.total());
 			}
-			if (convert_to_wbuffer(&cd, input_buffer, wbuffer,
-					bytes_read + unused_input_bytes,
-					wbuffer_size, &unused_input_bytes,
-					&characters_converted) > 0) {
-				std::cerr << "Character conversion error!\n";
+		}
+		if (cache_hit != 0) {
+			/* the sample would be less accurate anyway */
+			sample_bytes = 0;
+			sample_fraction = 0;
+		}
+		if ((sample_fraction > 0) || (sample_bytes > 0)) {
+			if (input_files.size() != 1) {
+				std::cerr << "The parameter --sample-corpus "
+					"requires a single input file!\n";
 				return (EXIT_FAILURE);
 			}
-			if (add_character_occurrences(occurrences,
-					wbuffer, characters_converted) > 0) {
-				std::cerr << "Could not determine "
-					"the numbers of occurrences\n"
-					"of the individual characters!\n";
+			/* we try to open the input file for reading */
+			ifd = open_corpus_file(input_files[0]);
+			if (ifd == (-1)) {
 				return (EXIT_FAILURE);
 			}
-			total_input_characters += characters_converted;
-		} while (retval == 0);
-		if (retval != (-1)) {
-			std::cerr << "Error: The last call to the function\n"
-				"text_file_read_buffer"
-				" has not been successful.\n";
-			return (EXIT_FAILURE);
+			if (fstat(ifd, &input_stat) == 0) {
+				if (sample_fraction > 0) {
+					sample_bytes = (size_t)(sample_fraction
+						* (double)(input_stat.st_size));
+					if (sample_bytes == 0) {
+						sample_bytes = 1;
+					}
+				}
+				/*
+				 * a sample of the entire file
+				 * is the file itself
+				 */
+				if (S_ISREG(input_stat.st_mode) &&
+						(sample_bytes >= (size_t)
+						 (input_stat.st_size))) {
+					sample_bytes = 0;
+				}
+			}
 		}
-		if (unused_input_bytes != (size_t)(0)) {
-			std::cerr << "Error: The last call to the function\n"
-				"convert_to_wbuffer"
-				" did not convert all the provided bytes.\n";
+		/* here, total_input_characters should be equal to 0 */
+		if (cache_hit != 0) {
+			std::cout << "Using the cached distribution '" <<
+				cache_path << "'.\n";
+		} else if (scan_hit != 0) {
+			std::cout << "Reusing the input files read "
+				"by an earlier job.\n";
+		} else if (sample_bytes > 0) {
+			if (ingest_corpus_sample(ifd, input_encoding,
+					internal_character_encoding,
+					ingest_thread_count,
+					sample_bytes,
+					(unsigned int)(seed), histogram,
+					&total_input_characters,
+					&sampled_bytes, half_widths) != 0) {
+				return (EXIT_FAILURE);
+			}
+			std::cout << "Sampled " << sampled_bytes <<
+				" bytes (" << total_input_characters <<
+				" characters) of the input file.\n";
+		} else if (follow_flag != 0) {
+			/*
+			 * the input file stays open, so that the follower
+			 * reads the appended bytes after the ones read here
+			 */
+			ifd = open_corpus_file(input_files[0]);
+			if ((ifd == (-1)) || (ingest_corpus_fd(ifd,
+					input_encoding,
+					internal_character_encoding,
+					ingest_thread_count, histogram,
+					&total_input_characters,
+					&follow_offset) != 0)) {
+				return (EXIT_FAILURE);
+			}
+		} else if (ingest_corpus_files(input_files, input_encoding,
+					internal_character_encoding,
+					ingest_thread_count, histogram,
+					&total_input_characters) != 0) {
 			return (EXIT_FAILURE);
 		}
-		delete[] input_buffer;
-		if (iconv_close(cd) == (-1)) {
-			perror("iconv_close 2");
+		if ((ifd != (-1)) && (follow_flag == 0) &&
+				(close_corpus_file(input_files[0], ifd) != 0)) {
 			return (EXIT_FAILURE);
 		}
-		if (close(ifd) == -1) {
-			perror("input_filename: close");
-			return (EXIT_FAILURE);
+		if ((cache_hit == 0) && (scan_hit == 0)) {
+			std::cout << ((input_files.size() == 1) ?
+					"Input file has" : "Input files have") <<
+				" been successfully read!\n";
 		}
-		std::cout << "Input file has been successfully read!\n";
 	}
 	delete[] wbuffer;
-	cum_sum = 0;
-	for (occurrences_map::iterator it = occurrences.begin();
-			it != occurrences.end(); ++it) {
-		cum_sum += it->second;
-		pmap[cum_sum] = it->first;
+	if (cache_hit == 0) {
+		/* folding the histogram into the occurrences_map */
+		histogram.fold(occurrences);
+		if (dist.build(occurrences) != 0) {
+			return (EXIT_FAILURE);
+		}
+	}
+	if ((!scan_key.empty()) && (scan_hit == 0)) {
+		(*scans)[scan_key].occurrences = occurrences;
+		(*scans)[scan_key].characters = total_input_characters;
 	}
-	if (total_input_characters != cum_sum) {
+	if (total_input_characters != dist.total()) {
 		std::cerr << "Something went wrong,\nbecause total number "
 			"of input characters (" << total_input_characters
 			<< ")\nis not equal to the cumulative "
 			"sum of the occurrences\nof all the characters (" <<
-			cum_sum << ").\n";
+			dist.total() << ").\n";
 		return (EXIT_FAILURE);
 	}
+	/* a sampled distribution is only approximate, so it is not cached */
+	if ((cache_hit == 0) && (!cache_path.empty()) && (sampled_bytes == 0)) {
+		if (store_distribution_cache(cache_directory, cache_path,
+				input_files, input_encoding,
+				ingest_thread_count, dist) == 0) {
+			if (verbose_flag != 0) {
+				std::cout << "The distribution has been "
+					"stored in the cache file '" <<
+					cache_path << "'.\n";
+			}
+		} else {
+			std::clog << "Warning: The distribution could not "
+				"be stored in the cache!\n";
+		}
+	}
 	if (verbose_flag != 0) {
-		std::cout << "Total alphabet size: " << pmap.size() << "\n";
+		std::cout << "Total alphabet size: " << dist.size() << "\n";
+	}
+	/* reporting the confidence bounds of the sampled frequencies */
+	if (!half_widths.empty()) {
+		double max_half_width = 0;
+		if (verbose_flag != 0) {
+			std::cout << "Estimated character frequencies "
+				"with their 95% confidence bounds:\n";
+		}
+		for (occurrences_map::iterator it = occurrences.begin();
+				it != occurrences.end(); ++it) {
+			if (half_widths[it->first] > max_half_width) {
+				max_half_width = half_widths[it->first];
+			}
+			if (verbose_flag != 0) {
+				std::cout << "U+" << std::hex <<
+					std::uppercase <<
+					std::setfill('0') << std::setw(4) <<
+					(unsigned long)(it->first) <<
+					std::dec << std::setfill(' ') <<
+					"\t" << std::fixed <<
+					std::setprecision(6) <<
+					(double)(it->second) /
+					(double)(total_input_characters) <<
+					" +- " << half_widths[it->first] <<
+					"\n";
+			}
+		}
+		std::cout << "Largest 95% confidence half-width "
+			"of a character frequency: " << std::fixed <<
+			std::setprecision(6) << max_half_width << "\n";
+	}
+	if (follow_flag != 0) {
+		if (follower.start(input_files[0].path.c_str(), ifd,
+				follow_offset, input_encoding,
+				internal_character_encoding,
+				occurrences, &dist) != 0) {
+			return (EXIT_FAILURE);
+		}
+		std::cout << "Following the input file '" <<
+			input_files[0].path << "'.\n";
 	}
 	/* initializing the pseudorandom number generator */
 	rsgen::instance(prng_type);
-	ofd = open(output_filename, O_WRONLY | O_CREAT | O_TRUNC,
-			S_IRUSR | S_IWUSR |
-			S_IRGRP | S_IWGRP |
-			S_IROTH | S_IWOTH);
-	if (ofd == -1) {
-		perror("output_filename: open");
-		return (EXIT_FAILURE);
+	/* the positional output file comes first */
+	if (output_filename != NULL) {
+		output_filenames.insert(output_filenames.begin(),
+				output_filename);
+		output_encodings.insert(output_encodings.begin(),
+				output_file_encoding);
 	}
-	if ((cd = iconv_open(output_file_encoding,
-			internal_character_encoding)) == (iconv_t)(-1)) {
-		perror("iconv_open 3");
+	/* an existing output file is not truncated in vain */
+	if ((mmap_flag != 0) && ((mmap_encoder.build(dist,
+					output_encodings[0].c_str(),
+					internal_character_encoding) != 0) ||
+				(mmap_encoder.fixed_length() == 0))) {
+		std::cerr << "The parameter --mmap requires "
+			"an output encoding, which encodes\n"
+			"every character in the same number of bytes!\n";
 		return (EXIT_FAILURE);
 	}
-	try {
-		output_wbuffer = new wchar_t[block_size];
-	} catch (std::bad_alloc &) {
-		std::cerr << "output_wbuffer allocation error!\n";
-		return (EXIT_FAILURE);
+	for (i = 0; i < output_filenames.size(); ++i) {
+		try {
+			output_targets.push_back(new output_target());
+		} catch (std::bad_alloc &) {
+			std::cerr << "output_target allocation error!\n";
+			return (EXIT_FAILURE);
+		}
+		if ((output_targets[i]->open(output_filenames[i].c_str(),
+					output_encodings[i].c_str(),
+					internal_character_encoding,
+					block_size) != 0) ||
+				(output_targets[i]->prepare(dist) != 0)) {
+			return (EXIT_FAILURE);
+		}
 	}
-	/*
-	 * we suppose that the maximum number of bytes that encode
-	 * a single UTF-8 character can never exceed 6
-	 */
-	output_buffer_size = block_size * 6;
-	try {
-		output_buffer = new char[output_buffer_size];
-	} catch (std::bad_alloc &) {
-		std::cerr << "output_buffer allocation error!\n";
-		return (EXIT_FAILURE);
+	/* the symbol indices shared by several output files */
+	if (output_targets.size() > 1) {
+		try {
+			output_indices = new uint32_t[block_size];
+		} catch (std::bad_alloc &) {
+			std::cerr << "output_indices allocation error!\n";
+			return (EXIT_FAILURE);
+		}
 	}
-	write_count = output_length / block_size;
-	write_size = output_length % block_size;
-	last_block_characters = write_size;
+	/* the blocks overlapping the range of the generated characters */
+	first_block = range_start / block_size;
+	write_count = (range_start + range_length + block_size - 1) /
+		block_size - first_block;
 	/*
 	 * we have to decrease the size of the interval of random numbers
 	 * by one, because we later add 1 to every generated random number
 	 */
 	scale_factor = (double)(total_input_characters - 1) /
 		(double)(UINT_MAX);
-	/* here, we suppose that total_bytes_written == 0 */
-	std::cout << "\nGenerating the random file '" <<
-		output_filename << "'\n";
-	std::cout << "Output file encoding: '" <<
-		output_file_encoding << "'\n";
-	for (i = 0; i < write_count; ++i) {
-		if (fill_output_wbuffer(output_wbuffer, block_size,
-					pmap, scale_factor) != 0) {
+	/* the range continues the output file written up to its start */
+	for (i = 0; i < output_targets.size(); ++i) {
+		if (output_targets[i]->resume(dist, scale_factor,
+					range_start) != 0) {
 			return (EXIT_FAILURE);
 		}
-		if (convert_from_wbuffer(&cd, output_wbuffer, output_buffer,
-				block_size, output_buffer_size,
-				&bytes_to_write) != 0) {
+	}
+	for (i = 0; i < output_targets.size(); ++i) {
+		std::cout << "\nGenerating the random file '" <<
+			output_targets[i]->filename() << "'\n";
+		std::cout << "Output file encoding: '" <<
+			output_targets[i]->encoding() << "'\n";
+		if (verbose_flag != 0) {
+			std::cout << "Output encoder: " <<
+				output_targets[i]->kernel() << "\n";
+		}
+	}
+	if (range_flag != 0) {
+		std::cout << "Generated range: characters " << range_start <<
+			" to " << (range_start + range_length) << " of " <<
+			output_length << "\n";
+	}
+	if (output_bytes != 0) {
+		if (output_targets[0]->generate_exact(dist, scale_factor,
+				output_bytes, (thread_count > 0) ?
+				thread_count : available_processors(),
+				&output_length) != 0) {
 			return (EXIT_FAILURE);
 		}
-		if (write(ofd, output_buffer, bytes_to_write) == (-1)) {
-			perror("output_filename: write 1");
+		range_length = output_length;
+		/* the blocks have already been written */
+		write_count = 0;
+	/* a single output file is generated in one of the parallel modes */
+	} else if ((output_targets.size() == 1) && (follow_flag == 0)) {
+		if (mmap_flag != 0) {
+			positioned_retval = output_targets[0]->generate_mapped(
+					dist, scale_factor, output_length,
+					(thread_count > 0) ? thread_count : 1);
+			if (positioned_retval < 0) {
+				std::cerr << "The parameter --mmap requires "
+					"a regular output file\n"
+					"and an output encoding, "
+					"which encodes every character\n"
+					"in the same number of bytes!\n";
+			}
+		/* the fixed-width blocks are written by the threads themselves */
+		} else if ((thread_count > 1) && (range_flag == 0)) {
+			positioned_retval = output_targets[0]->
+				generate_positioned(dist, scale_factor,
+						output_length, thread_count);
+		} else {
+			positioned_retval = (-1);
+		}
+		/* otherwise, the blocks are written by a separate thread */
+		if ((positioned_retval < 0) && (mmap_flag == 0)) {
+			positioned_retval = output_targets[0]->generate_ordered(
+					dist, scale_factor,
+					range_start, range_length,
+					(thread_count > 0) ? thread_count : 1,
+					write_buffers);
+		}
+		if (positioned_retval != 0) {
 			return (EXIT_FAILURE);
 		}
-		total_bytes_written += bytes_to_write;
+		write_count = 0;
 	}
-	if (write_size > 0) {
-		if (fill_output_wbuffer(output_wbuffer, last_block_characters,
-					pmap, scale_factor) != 0) {
+	for (block = first_block; block < first_block + write_count; ++block) {
+		block_start = std::max(range_start, block * block_size);
+		block_characters = std::min((block + 1) * block_size,
+				range_start + range_length) - block_start;
+		/* picking up the updated distribution of the followed file */
+		if (follow_flag != 0) {
+			block_dist = follower.acquire();
+			scale_factor = (double)(block_dist->total() - 1) /
+				(double)(UINT_MAX);
+			/* the updated distribution may contain new symbols */
+			for (j = 0; j < output_targets.size(); ++j) {
+				if (output_targets[j]->prepare(*block_dist)
+						!= 0) {
+					return (EXIT_FAILURE);
+				}
+			}
+		}
+		/* every block is generated from its own seed */
+		rsgen::get_instance()->reseed(block, 0);
+		/*
+		 * a single output file is only generated here if it
+		 * is followed, so the range is the whole output file
+		 */
+		if (output_targets.size() == 1) {
+			if ((output_targets[0]->generate(*block_dist,
+					block_characters,
+					scale_factor) != 0) ||
+					(output_targets[0]->flush() != 0)) {
+				return (EXIT_FAILURE);
+			}
+		/*
+		 * the characters are sampled once for all the output files,
+		 * including the ones of the block preceding the range
+		 */
+		} else if ((fill_symbol_indices(output_indices,
+					block_start - block * block_size +
+					block_characters, *block_dist,
+					scale_factor) != 0) ||
+				(encode_output_targets(output_targets,
+					*block_dist, output_indices +
+					(block_start - block * block_size),
+					block_characters,
+					(thread_count > 0) ? thread_count :
+					available_processors()) != 0)) {
 			return (EXIT_FAILURE);
 		}
-		if (convert_from_wbuffer(&cd, output_wbuffer, output_buffer,
-				last_block_characters,
-				output_buffer_size,
-				&bytes_to_write) != 0) {
+	}
+	for (i = 0; i < output_targets.size(); ++i) {
+		std::cout << "Successfully written " << range_length <<
+			" characters (" << output_targets[i]->bytes_written() <<
+			" bytes)";
+		if (output_targets.size() > 1) {
+			std::cout << " to '" <<
+				output_targets[i]->filename() << "'";
+		}
+		std::cout << "\n";
+	}
+	if (verbose_flag != 0) {
+		print_utilisation();
+	}
+	if (numa_flag != 0) {
+		print_numa_placement();
+	}
+	if (follow_flag != 0) {
+		if (follower.stop() != 0) {
+			std::clog << "Warning: The input file could not "
+				"be followed until the end!\n";
+		}
+		if (verbose_flag != 0) {
+			std::cout << "Distribution updates: " <<
+				follower.updates() << " (" <<
+				follower.appended_characters() <<
+				" appended characters)\n";
+		}
+		if (close_corpus_file(input_files[0], ifd) != 0) {
 			return (EXIT_FAILURE);
 		}
-		if (write(ofd, output_buffer, bytes_to_write) == (-1)) {
-			perror("output_filename: write 2");
+	}
+	delete[] output_indices;
+	for (i = 0; i < output_targets.size(); ++i) {
+		if (output_targets[i]->close() != 0) {
 			return (EXIT_FAILURE);
 		}
-		total_bytes_written += bytes_to_write;
+		delete output_targets[i];
 	}
-	std::cout << "Successfully written " << output_length <<
-		" characters (" << total_bytes_written << " bytes)\n";
-	delete[] output_buffer;
-	delete[] output_wbuffer;
-	if (iconv_close(cd) == (-1)) {
-		perror("iconv_close 3");
+	return (EXIT_SUCCESS);
+}
+
+/**
+ * A function which splits a line of the manifest into the parameters.
+ * The parameters are separated by the white space.
+ * The single quotes preserve the enclosed characters, the double quotes
+ * preserve them except for the backslash escaping the next character,
+ * and the backslash outside of the quotes escapes the next character.
+ * An unquoted number sign at the start of a parameter begins a comment,
+ * which extends to the end of the line.
+ *
+ * @param
+ * line		the line of the manifest
+ * @param
+ * parameters	the vector, to which the parameters are appended
+ *
+ * @return	If the line has been successfully split,
+ * 		this function returns zero.
+ * 		If the line contains an unmatched quote,
+ * 		it returns one (1).
+ */
+int split_manifest_line (const std::string &line,
+		std::vector<std::string> &parameters) {
+	std::string parameter;
+	/* indicates whether a parameter, possibly empty, has started */
+	int started = 0;
+	/* the quote character, which is open, or zero */
+	char quote = 0;
+	size_t i = 0;
+	for (i = 0; i < line.size(); ++i) {
+		char c = line[i];
+		if (quote == '\'') {
+			if (c == '\'') {
+				quote = 0;
+			} else {
+				parameter += c;
+			}
+		} else if (quote == '"') {
+			if (c == '"') {
+				quote = 0;
+			} else if ((c == '\\') && (i + 1 < line.size())) {
+				parameter += line[++i];
+			} else {
+				parameter += c;
+			}
+		} else if ((c == ' ') || (c == '\t') || (c == '\r')) {
+			if (started != 0) {
+				parameters.push_back(parameter);
+				parameter.clear();
+				started = 0;
+			}
+		} else if ((c == '#') && (started == 0)) {
+			break;
+		} else {
+			started = 1;
+			if ((c == '\'') || (c == '"')) {
+				quote = c;
+			} else if ((c == '\\') && (i + 1 < line.size())) {
+				parameter += line[++i];
+			} else {
+				parameter += c;
+			}
+		}
+	}
+	if (quote != 0) {
+		return (1);
+	}
+	if (started != 0) {
+		parameters.push_back(parameter);
+	}
+	return (0);
+}
+
+/**
+ * A function which runs the generation jobs listed in the manifest,
+ * one job per line. The jobs run one after another in this process,
+ * so the corpus files read by a job and the encoder tables built
+ * by it are reused by the later jobs instead of being built again.
+ * The first failing job stops the manifest.
+ *
+ * @param
+ * argv0	the argv[0], or the command used to run this program
+ * @param
+ * manifest_path	the path of the manifest
+ *
+ * @return	If all the jobs of the manifest have succeeded,
+ * 		this function returns EXIT_SUCCESS.
+ * 		Otherwise, it returns EXIT_FAILURE.
+ */
+int run_manifest (const char *argv0, const char *manifest_path) {
+	std::ifstream manifest(manifest_path);
+	std::string line;
+	std::vector<std::string> parameters;
+	/* the modifiable copies of the parameters of a job */
+	std::vector<std::vector<char> > buffers;
+	std::vector<char *> job_argv;
+	corpus_scan_map scans;
+	size_t line_number = 0;
+	size_t job_count = 0;
+	size_t i = 0;
+	if (!manifest) {
+		std::cerr << "The manifest '" << manifest_path <<
+			"' could not be opened!\n";
 		return (EXIT_FAILURE);
 	}
-	if (close(ofd) == -1) {
-		perror("output_filename: close");
+	symbol_encoder::enable_cache();
+	while (std::getline(manifest, line)) {
+		++line_number;
+		parameters.clear();
+		if (split_manifest_line(line, parameters) != 0) {
+			std::cerr << "The line " << line_number <<
+				" of the manifest contains "
+				"an unmatched quote!\n";
+			return (EXIT_FAILURE);
+		}
+		if (parameters.empty()) {
+			continue;
+		}
+		buffers.assign(1, std::vector<char>(argv0,
+					argv0 + strlen(argv0) + 1));
+		for (i = 0; i < parameters.size(); ++i) {
+			buffers.push_back(std::vector<char>(
+						parameters[i].begin(),
+						parameters[i].end()));
+			buffers.back().push_back('\0');
+		}
+		job_argv.clear();
+		for (i = 0; i < buffers.size(); ++i) {
+			job_argv.push_back(&(buffers[i][0]));
+		}
+		job_argv.push_back(NULL);
+		++job_count;
+		std::cout << "Manifest job " << job_count << " (line " <<
+			line_number << ")\n";
+		/* the getopt_long starts scanning the new job from scratch */
+		optind = 0;
+		if (generate((int)(buffers.size()), &(job_argv[0]),
+					&scans) != EXIT_SUCCESS) {
+			std::cerr << "The job on the line " << line_number <<
+				" of the manifest has failed!\n";
+			return (EXIT_FAILURE);
+		}
+	}
+	if (manifest.bad()) {
+		std::cerr << "The manifest '" << manifest_path <<
+			"' could not be read!\n";
 		return (EXIT_FAILURE);
 	}
+	std::cout << "Successfully completed " << job_count <<
+		((job_count == 1) ? " job" : " jobs") <<
+		" of the manifest.\n";
 	return (EXIT_SUCCESS);
 }
+
+/**
+ * The main function.
+ * It either runs the jobs of the manifest, or generates a single file
+ * containing the random characters of the desired kind.
+ *
+ * @param
+ * argc		the argument count, or the number of program arguments
+ * 		(including the argv[0])
+ * @param
+ * argv		the argument vector itself, or an array of argument strings
+ *
+ * @return	If the file or files containing the random characters
+ * 		of the desired kind have been successfully created,
+ * 		this function returns EXIT_SUCCESS.
+ * 		Otherwise, it returns EXIT_FAILURE.
+ */
+int main (int argc, char **argv) {
+	if ((argc == 3) && (strcmp(argv[1], "--manifest") == 0)) {
+		return (run_manifest(argv[0], argv[2]));
+	}
+	return (generate(argc, argv, NULL));
+}
@@ -0,0 +1,524 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/**
+ * @file
+ * The pseudorandom string generator NUMA placement.
+ * This file contains the implementation of functions,
+ * which are used to discover the NUMA nodes, to pin the worker threads
+ * and the writer thread to them and to report the achieved placement.
+ *
+ * The nodes and their CPUs are read from the sysfs, the threads
+ * are pinned by their CPU affinity and the nodes of the memory pages
+ * are queried by the move_pages system call, so no NUMA library
+ * is needed. The buffers are not bound explicitly. They are allocated
+ * untouched and first touched by the pinned workers filling them,
+ * so the kernel places them on the nodes of these workers.
+ */
+
+#include "numa.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <vector>
+
+/* auxiliary structures */
+
+/* a single NUMA node */
+struct numa_node {
+	int id;
+	/* the CPUs of the node as listed by the sysfs, like 0-3,8-11 */
+	std::string cpu_list;
+	cpu_set_t cpus;
+};
+
+/* global variables */
+
+/* the NUMA nodes, empty if they have not been discovered */
+static std::vector<numa_node> numa_nodes;
+
+/* indicates whether the threads should be pinned to the nodes */
+static int numa_placement = 0;
+
+/* the nodes the workers have run on, by their indices */
+static volatile int numa_worker_nodes[numa_recorded_workers];
+
+/* the nodes of the buffers filled by the workers, by their indices */
+static volatile int numa_buffer_nodes[numa_recorded_workers];
+
+/* the node the writer thread has run on */
+static volatile int numa_writer_node = numa_unknown_node;
+
+/* the node of the device of the output file */
+static volatile int numa_device_node = numa_unknown_node;
+
+/* static functions */
+
+/**
+ * A function which reads the first line of a sysfs file.
+ *
+ * @param
+ * path		the path of the file
+ * @param
+ * line		when this function returns, this variable
+ * 		will be set to the line without its end
+ *
+ * @return	If the line has been successfully read,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int read_sysfs_line (const std::string &path, std::string &line) {
+	char buffer[4096];
+	ssize_t read_retval = 0;
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd == (-1)) {
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	read_retval = read(fd, buffer, sizeof (buffer) - 1);
+	::close(fd);
+	if (read_retval <= 0) {
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	buffer[read_retval] = '\0';
+	buffer[strcspn(buffer, "\n")] = '\0';
+	line = buffer;
+	return (0);
+}
+
+/**
+ * A function which parses a sysfs list of numbers and their ranges,
+ * like 0-3,8-11.
+ *
+ * @param
+ * list		the list
+ * @param
+ * numbers	the numbers of the list will be appended to this vector
+ *
+ * @return	If the list has been successfully parsed,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int parse_sysfs_list (const std::string &list,
+		std::vector<int> &numbers) {
+	const char *position = list.c_str();
+	char *endptr = NULL;
+	long first = 0;
+	long last = 0;
+	while ((*position) != '\0') {
+		first = strtol(position, &endptr, 10);
+		if (endptr == position) {
+			return (1);
+		}
+		last = first;
+		if ((*endptr) == '-') {
+			position = endptr + 1;
+			last = strtol(position, &endptr, 10);
+			if ((endptr == position) || (last < first)) {
+				return (1);
+			}
+		}
+		for (; first <= last; ++first) {
+			numbers.push_back((int)(first));
+		}
+		if ((*endptr) == ',') {
+			++endptr;
+		} else if ((*endptr) != '\0') {
+			return (1);
+		}
+		position = endptr;
+	}
+	return (0);
+}
+
+/**
+ * A function which returns the node of the CPU.
+ *
+ * @param
+ * cpu		the CPU
+ *
+ * @return	This function returns the node of the CPU,
+ * 		or numa_unknown_node if it is not known.
+ */
+static int node_of_cpu (int cpu) {
+	for (size_t i = 0; (cpu >= 0) && (i < numa_nodes.size()); ++i) {
+		if (CPU_ISSET((size_t)(cpu), &(numa_nodes[i].cpus))) {
+			return (numa_nodes[i].id);
+		}
+	}
+	return (numa_unknown_node);
+}
+
+/**
+ * A function which returns the node of the memory page
+ * containing the address.
+ *
+ * @param
+ * address	the address
+ *
+ * @return	This function returns the node of the page,
+ * 		or numa_unknown_node if it is not known,
+ * 		for example if it has not been touched yet.
+ */
+static int node_of_address (const void *address) {
+#ifdef SYS_move_pages
+	const size_t page_size = (size_t)(sysconf(_SC_PAGESIZE));
+	/* no nodes are passed, so the pages are only queried */
+	void *pages[1];
+	int status[1];
+	pages[0] = (void *)((size_t)(address) / page_size * page_size);
+	status[0] = numa_unknown_node;
+	if ((syscall(SYS_move_pages, 0, 1UL, pages, NULL, status, 0) != 0) ||
+			(status[0] < 0)) {
+		/* resetting the errno */
+		errno = 0;
+		return (numa_unknown_node);
+	}
+	return (status[0]);
+#else
+	(void)(address);
+	return (numa_unknown_node);
+#endif
+}
+
+/**
+ * A function which pins the calling thread to the CPUs of the node.
+ *
+ * @param
+ * node		the index of the node in the numa_nodes
+ *
+ * @return	If the thread has been successfully pinned,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int bind_to_node (size_t node) {
+	if (sched_setaffinity(0, sizeof (cpu_set_t),
+				&(numa_nodes[node].cpus)) == (-1)) {
+		perror("numa: sched_setaffinity");
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	return (0);
+}
+
+/* regular functions */
+
+/**
+ * A function which discovers the NUMA nodes and their CPUs,
+ * unless they have already been discovered.
+ *
+ * @return	This function returns the number of the discovered nodes,
+ * 		or zero if the system does not describe them.
+ */
+size_t numa_discover () {
+	const std::string sysfs_nodes = "/sys/devices/system/node/";
+	std::string line;
+	std::vector<int> ids;
+	std::vector<int> cpus;
+	std::ostringstream path;
+	numa_node node;
+	size_t i = 0;
+	size_t j = 0;
+	if (!numa_nodes.empty()) {
+		return (numa_nodes.size());
+	}
+	for (i = 0; i < numa_recorded_workers; ++i) {
+		numa_worker_nodes[i] = numa_unknown_node;
+		numa_buffer_nodes[i] = numa_unknown_node;
+	}
+	if ((read_sysfs_line(sysfs_nodes + "online", line) != 0) ||
+			(parse_sysfs_list(line, ids) != 0)) {
+		return (0);
+	}
+	for (i = 0; i < ids.size(); ++i) {
+		path.str("");
+		path << sysfs_nodes << "node" << ids[i] << "/cpulist";
+		cpus.clear();
+		node.id = ids[i];
+		node.cpu_list.clear();
+		CPU_ZERO(&(node.cpus));
+		/* the nodes without any CPUs only provide the memory */
+		if ((read_sysfs_line(path.str(), node.cpu_list) != 0) ||
+				(parse_sysfs_list(node.cpu_list, cpus) != 0) ||
+				(cpus.empty())) {
+			continue;
+		}
+		for (j = 0; j < cpus.size(); ++j) {
+			if ((size_t)(cpus[j]) < CPU_SETSIZE) {
+				CPU_SET((size_t)(cpus[j]), &(node.cpus));
+			}
+		}
+		numa_nodes.push_back(node);
+	}
+	return (numa_nodes.size());
+}
+
+/**
+ * A function which enables pinning the worker threads
+ * and the writer thread to the NUMA nodes.
+ *
+ * @return	If the nodes have been discovered,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int numa_enable_placement () {
+	if (numa_discover() == 0) {
+		std::cerr << "The NUMA nodes could not be discovered!\n";
+		return (1);
+	}
+	numa_placement = 1;
+	return (0);
+}
+
+/**
+ * A function which disables pinning the threads to the NUMA nodes,
+ * so that a job of the manifest without the --numa parameter
+ * is not placed like the earlier jobs.
+ */
+void numa_disable_placement () {
+	numa_placement = 0;
+}
+
+/**
+ * A function which determines the NUMA node of the block device
+ * holding the file. The node of a partition is the one
+ * of its whole device and the node of an NVMe namespace
+ * is the one of its controller.
+ *
+ * @param
+ * fd		the file descriptor of the file
+ *
+ * @return	This function returns the node of the device,
+ * 		or numa_unknown_node if it is not known.
+ */
+int numa_node_of_file (int fd) {
+	static const char *const candidates[] = {
+		"/device/numa_node",
+		"/device/device/numa_node",
+		"/../device/numa_node",
+		"/../device/device/numa_node",
+		NULL
+	};
+	struct stat file_stat;
+	std::ostringstream device;
+	std::string line;
+	char *endptr = NULL;
+	long node = 0;
+	if (fstat(fd, &file_stat) == (-1)) {
+		/* resetting the errno */
+		errno = 0;
+		return (numa_unknown_node);
+	}
+	/* the device of a regular file, or the block device itself */
+	device << "/sys/dev/block/" <<
+		major(S_ISBLK(file_stat.st_mode) ? file_stat.st_rdev :
+				file_stat.st_dev) << ":" <<
+		minor(S_ISBLK(file_stat.st_mode) ? file_stat.st_rdev :
+				file_stat.st_dev);
+	for (size_t i = 0; candidates[i] != NULL; ++i) {
+		if (read_sysfs_line(device.str() + candidates[i], line) != 0) {
+			continue;
+		}
+		node = strtol(line.c_str(), &endptr, 10);
+		if ((endptr != line.c_str()) && (node >= 0)) {
+			return ((int)(node));
+		}
+	}
+	return (numa_unknown_node);
+}
+
+/**
+ * A function which saves the CPU affinity of the calling thread,
+ * if the threads are pinned to the nodes.
+ *
+ * @param
+ * affinity	the saved affinity
+ *
+ * @return	This function always returns zero (0).
+ */
+int numa_save_affinity (numa_affinity &affinity) {
+	affinity.saved = 0;
+	if ((numa_placement != 0) && (sched_getaffinity(0,
+					sizeof (cpu_set_t),
+					&(affinity.mask)) == 0)) {
+		affinity.saved = 1;
+	}
+	/* resetting the errno */
+	errno = 0;
+	return (0);
+}
+
+/**
+ * A function which restores the saved CPU affinity
+ * of the calling thread.
+ *
+ * @param
+ * affinity	the saved affinity
+ *
+ * @return	If the affinity has been restored or if it has not been
+ * 		saved, this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int numa_restore_affinity (const numa_affinity &affinity) {
+	if ((affinity.saved != 0) && (sched_setaffinity(0,
+					sizeof (cpu_set_t),
+					&(affinity.mask)) == (-1))) {
+		perror("numa: sched_setaffinity");
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	return (0);
+}
+
+/**
+ * A function which pins the calling worker thread to its node,
+ * if the threads are pinned to the nodes. The workers are split
+ * into consecutive groups of roughly the same size, one per node,
+ * so the neighbouring workers share a node.
+ *
+ * @param
+ * worker_index	the index of the worker
+ * @param
+ * worker_count	the number of the workers
+ *
+ * @return	If the worker has been successfully pinned,
+ * 		or if the threads are not pinned at all,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int numa_place_worker (size_t worker_index, size_t worker_count) {
+	const size_t node = (worker_count > 0) ?
+		worker_index * numa_nodes.size() / worker_count : 0;
+	if ((numa_placement == 0) || (node >= numa_nodes.size())) {
+		return (0);
+	}
+	if (bind_to_node(node) != 0) {
+		return (1);
+	}
+	if (worker_index < numa_recorded_workers) {
+		numa_worker_nodes[worker_index] = node_of_cpu(sched_getcpu());
+	}
+	return (0);
+}
+
+/**
+ * A function which pins the calling writer thread
+ * to the node of the device of the output file,
+ * if the threads are pinned to the nodes and if the node is known.
+ *
+ * @param
+ * fd		the file descriptor of the output file
+ *
+ * @return	If the writer has been successfully pinned,
+ * 		or if it is not pinned at all,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int numa_place_writer (int fd) {
+	if (numa_placement == 0) {
+		return (0);
+	}
+	numa_device_node = numa_node_of_file(fd);
+	for (size_t i = 0; i < numa_nodes.size(); ++i) {
+		if (numa_nodes[i].id == numa_device_node) {
+			if (bind_to_node(i) != 0) {
+				return (1);
+			}
+			break;
+		}
+	}
+	numa_writer_node = node_of_cpu(sched_getcpu());
+	return (0);
+}
+
+/**
+ * A function which records the node of the buffer filled
+ * by the worker, if the threads are pinned to the nodes.
+ *
+ * @param
+ * worker_index	the index of the worker
+ * @param
+ * buffer	the buffer, which has already been filled
+ */
+void numa_note_buffer (size_t worker_index, const void *buffer) {
+	if ((numa_placement == 0) || (worker_index >= numa_recorded_workers)) {
+		return;
+	}
+	numa_buffer_nodes[worker_index] = node_of_address(buffer);
+}
+
+/**
+ * A function which prints the discovered NUMA nodes and their CPUs.
+ *
+ * @return	This function always returns zero (0).
+ */
+int print_numa_topology () {
+	std::cout << "NUMA nodes: " << numa_discover() << "\n";
+	for (size_t i = 0; i < numa_nodes.size(); ++i) {
+		std::cout << "Node " << numa_nodes[i].id << ": CPUs " <<
+			numa_nodes[i].cpu_list << "\n";
+	}
+	return (0);
+}
+
+/**
+ * A function which prints the nodes the worker threads,
+ * their buffers and the writer thread have been placed on.
+ *
+ * @return	This function always returns zero (0).
+ */
+int print_numa_placement () {
+	std::cout << "NUMA placement:\n";
+	for (size_t i = 0; (i < numa_recorded_workers) &&
+			(numa_worker_nodes[i] != numa_unknown_node); ++i) {
+		std::cout << "Worker " << i << ": node " <<
+			numa_worker_nodes[i] << ", buffer node ";
+		if (numa_buffer_nodes[i] == numa_unknown_node) {
+			std::cout << "unknown\n";
+		} else {
+			std::cout << numa_buffer_nodes[i] << "\n";
+		}
+	}
+	if (numa_writer_node != numa_unknown_node) {
+		std::cout << "Writer: node " << numa_writer_node <<
+			", output device node ";
+		if (numa_device_node == numa_unknown_node) {
+			std::cout << "unknown\n";
+		} else {
+			std::cout << numa_device_node << "\n";
+		}
+	}
+	return (0);
+}
@@ -0,0 +1,1536 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator output files.
+ * This file contains the implementation of the class and functions,
+ * which are used to encode the generated characters
+ * and to write them to one or more output files.
+ */
+
+#include "output.h"
+#include "numa.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/* data types */
+
+/* the shared context of the tasks encoding a block to the output files */
+struct output_encoding_run {
+	output_target_list *targets;
+	const distribution *dist;
+	const uint32_t *indices;
+	size_t characters;
+};
+
+/* a block of the output of the exact size */
+struct exact_block {
+	uint32_t *indices;
+	char *buffer;
+	size_t characters;
+	size_t bytes;
+	/* the offset of the block in the output file */
+	size_t offset;
+};
+
+/* the shared context of the tasks writing the blocks of the exact size */
+struct exact_run {
+	int fd;
+	const char *path;
+	const symbol_encoder *encoder;
+	const distribution *dist;
+	double scale_factor;
+	size_t block_size;
+	/* the index of the first block of the current round */
+	size_t first_block;
+	exact_block *blocks;
+};
+
+/* the shared context of the tasks writing the fixed-width blocks */
+struct positioned_run {
+	int fd;
+	const char *path;
+	const symbol_encoder *encoder;
+	const distribution *dist;
+	int uniform;
+	double scale_factor;
+	size_t block_size;
+	size_t characters;
+	/* the output buffers of the worker threads */
+	char **buffers;
+};
+
+/* the shared context of the tasks generating into the mapped file */
+struct mapped_run {
+	int fd;
+	const char *path;
+	/* the mapped output file, followed by slot_size spare bytes */
+	char *mapping;
+	size_t page_size;
+	size_t width;
+	const symbol_encoder *encoder;
+	const distribution *dist;
+	int uniform;
+	double scale_factor;
+	size_t block_size;
+	size_t characters;
+	/* the blocks of the current phase are either even or odd */
+	size_t phase;
+};
+
+/* a slot of the ring of the blocks generated in a parallel */
+struct ordered_slot {
+	char *buffer;
+	size_t bytes;
+	/*
+	 * the sequence number of the slot, 2k if it is free
+	 * for the block k and 2k + 1 if the block k is ready
+	 */
+	volatile size_t sequence;
+};
+
+/* the shared context of the ordered generation of the blocks */
+struct ordered_run {
+	int fd;
+	const char *path;
+	/* the conversion descriptor, if the blocks are converted by iconv */
+	iconv_t *cd;
+	wchar_t *wbuffer;
+	size_t slot_buffer_size;
+	const symbol_encoder *encoder;
+	const distribution *dist;
+	int uniform;
+	double scale_factor;
+	size_t block_size;
+	/* the index of the first generated character in the output file */
+	size_t first;
+	size_t characters;
+	size_t block_count;
+	ordered_slot *slots;
+	size_t slot_count;
+	/* the number of bytes written by the writer thread */
+	size_t written_bytes;
+	/* nonzero if any of the threads has failed */
+	volatile int failed;
+};
+
+/* constants */
+
+/* the number of times a waiting thread yields before it starts to sleep */
+static const unsigned int ordered_spin_limit = 64;
+
+/* the sleeping time of a waiting thread, in microseconds */
+static const useconds_t ordered_sleep_time = 50;
+
+/* functions */
+
+/**
+ * A function which writes the whole buffer to the output file.
+ *
+ * @param
+ * fd		the file descriptor of the output file
+ * @param
+ * path		the name of the output file
+ * @param
+ * buffer	the bytes to write
+ * @param
+ * bytes	the number of bytes to write
+ *
+ * @return	If the bytes have been successfully written,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int write_block (int fd,
+		const char *path,
+		const char *buffer,
+		size_t bytes) {
+	ssize_t write_retval = 0;
+	while (bytes > 0) {
+		write_retval = write(fd, buffer, bytes);
+		if (write_retval == (-1)) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror(path);
+			/* resetting the errno */
+			errno = 0;
+			return (1);
+		}
+		buffer += write_retval;
+		bytes -= (size_t)(write_retval);
+	}
+	return (0);
+}
+
+/**
+ * A function which writes the whole buffer
+ * to the specified offset of the output file.
+ *
+ * @param
+ * fd		the file descriptor of the output file
+ * @param
+ * path		the name of the output file
+ * @param
+ * buffer	the bytes to write
+ * @param
+ * bytes	the number of bytes to write
+ * @param
+ * offset	the offset of the first byte in the output file
+ *
+ * @return	If the bytes have been successfully written,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int pwrite_block (int fd,
+		const char *path,
+		const char *buffer,
+		size_t bytes,
+		size_t offset) {
+	ssize_t pwrite_retval = 0;
+	while (bytes > 0) {
+		pwrite_retval = pwrite(fd, buffer, bytes, (off_t)(offset));
+		if (pwrite_retval == (-1)) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror(path);
+			/* resetting the errno */
+			errno = 0;
+			return (1);
+		}
+		buffer += pwrite_retval;
+		offset += (size_t)(pwrite_retval);
+		bytes -= (size_t)(pwrite_retval);
+	}
+	return (0);
+}
+
+/**
+ * A function which generates the block of pseudorandom characters
+ * encoded by the symbol encoder into the buffer.
+ *
+ * @param
+ * buffer	the output buffer
+ * @param
+ * characters	the number of characters of the block
+ * @param
+ * dist		the distribution of the characters
+ * @param
+ * encoder	the symbol encoder of the distribution
+ * @param
+ * uniform	nonzero if the characters are picked by the random bytes
+ * @param
+ * scale_factor	the factor used to scale the pseudorandom numbers
+ * 		to the total number of occurrences
+ * @param
+ * bytes	when this function returns, this variable
+ * 		will be set to the number of bytes of the block
+ *
+ * @return	If the block has been successfully generated,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int fill_encoded_block (char *buffer,
+		size_t characters,
+		const distribution &dist,
+		const symbol_encoder &encoder,
+		int uniform,
+		double scale_factor,
+		size_t *bytes) {
+	if (uniform != 0) {
+		return (fill_output_uniform(buffer, 0, characters, encoder,
+					bytes));
+	}
+	return (fill_output_buffer(buffer, characters, dist, encoder,
+				scale_factor, bytes));
+}
+
+/**
+ * A function which generates the part of the block of pseudorandom
+ * characters following its first skipped characters, encoded
+ * by the symbol encoder into the buffer. The skipped characters
+ * are generated as well, so that the part is the same
+ * as in the whole block.
+ *
+ * @param
+ * buffer	the output buffer, which has to be able to hold
+ * 		the encoded skipped characters as well
+ * @param
+ * skip		the number of the skipped characters
+ * @param
+ * characters	the number of characters following them
+ * @param
+ * dist		the distribution of the characters
+ * @param
+ * encoder	the symbol encoder of the distribution
+ * @param
+ * uniform	nonzero if the characters are picked by the random bytes
+ * @param
+ * scale_factor	the factor used to scale the pseudorandom numbers
+ * 		to the total number of occurrences
+ * @param
+ * bytes	when this function returns, this variable
+ * 		will be set to the number of bytes of the part
+ *
+ * @return	If the part of the block has been successfully generated,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int fill_encoded_range (char *buffer,
+		size_t skip,
+		size_t characters,
+		const distribution &dist,
+		const symbol_encoder &encoder,
+		int uniform,
+		double scale_factor,
+		size_t *bytes) {
+	if (skip == 0) {
+		return (fill_encoded_block(buffer, characters, dist, encoder,
+					uniform, scale_factor, bytes));
+	}
+	/* the random bytes are drawn by whole chunks from the block start */
+	if (uniform != 0) {
+		return ((fill_output_uniform(buffer, skip, characters, encoder,
+					bytes) != 0) ? 1 : 0);
+	}
+	/* otherwise, every character takes a single pseudorandom number */
+	if ((fill_encoded_block(buffer, skip, dist, encoder, uniform,
+					scale_factor, bytes) != 0) ||
+			(fill_encoded_block(buffer, characters, dist, encoder,
+					uniform, scale_factor, bytes) != 0)) {
+		return (1);
+	}
+	return (0);
+}
+
+/**
+ * A function which waits until the sequence number of a slot
+ * reaches the specified value. The waiting thread yields
+ * the processor for a while and then it sleeps between the checks.
+ *
+ * @param
+ * sequence	the sequence number of the slot
+ * @param
+ * value	the awaited value
+ * @param
+ * failed	the failure flag of the run
+ *
+ * @return	If the sequence number has reached the value,
+ * 		this function returns zero.
+ * 		If the run has failed in the meantime, it returns one (1).
+ */
+static int wait_for_sequence (const volatile size_t *sequence,
+		size_t value,
+		const volatile int *failed) {
+	unsigned int spins = 0;
+	while ((*sequence) != value) {
+		if ((*failed) != 0) {
+			return (1);
+		}
+		if (spins < ordered_spin_limit) {
+			++spins;
+			sched_yield();
+		} else {
+			usleep(ordered_sleep_time);
+		}
+	}
+	/* the contents of the slot are read only after its sequence */
+	__sync_synchronize();
+	return (0);
+}
+
+/**
+ * A task which generates a single block into its slot of the ring,
+ * once the writer thread has released the slot.
+ * The generator is reseeded by the index of the block,
+ * so that the block does not depend on the thread generating it.
+ * Only the characters of the block from the first generated one on
+ * are kept, so a part of the output file may start inside the block.
+ *
+ * @param
+ * context	the ordered_run
+ * @param
+ * task_index	the index of the block among the generated blocks
+ * @param
+ * worker_index	the index of the worker thread
+ *
+ * @return	If the block has been successfully generated,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int ordered_block_task (void *context,
+		size_t task_index,
+		size_t worker_index) {
+	ordered_run *run = (ordered_run *)(context);
+	ordered_slot *slot = run->slots + (task_index % run->slot_count);
+	const size_t block = run->first / run->block_size + task_index;
+	const size_t start = std::max(run->first, block * run->block_size);
+	const size_t characters = std::min((block + 1) * run->block_size,
+			run->first + run->characters) - start;
+	/* the characters of the block preceding the first generated one */
+	const size_t skip = start - block * run->block_size;
+	if (wait_for_sequence(&(slot->sequence), 2 * task_index,
+				&(run->failed)) != 0) {
+		return (1);
+	}
+	try {
+		rsgen::local_instance()->reseed(block, 0);
+	} catch (std::bad_alloc &) {
+		std::cerr << "output_target: generator allocation error!\n";
+		run->failed = 1;
+		return (1);
+	}
+	if (run->cd != NULL) {
+		if ((fill_output_wbuffer(run->wbuffer, skip + characters,
+					*(run->dist),
+					run->scale_factor) != 0) ||
+				(convert_from_wbuffer(run->cd,
+					run->wbuffer + skip,
+					slot->buffer, characters,
+					run->slot_buffer_size,
+					&(slot->bytes)) != 0)) {
+			run->failed = 1;
+			return (1);
+		}
+	} else if (fill_encoded_range(slot->buffer, skip, characters,
+				*(run->dist), *(run->encoder), run->uniform,
+				run->scale_factor, &(slot->bytes)) != 0) {
+		run->failed = 1;
+		return (1);
+	}
+	numa_note_buffer(worker_index, slot->buffer);
+	/* the contents of the slot are written before its sequence */
+	__sync_synchronize();
+	slot->sequence = 2 * task_index + 1;
+	return (0);
+}
+
+/**
+ * A function executed by the writer thread of the ordered generation.
+ * It writes the blocks in their order as soon as they are ready
+ * and releases their slots for the blocks following them.
+ *
+ * @param
+ * argument	the ordered_run
+ *
+ * @return	This function always returns NULL.
+ */
+static void *ordered_writer_main (void *argument) {
+	ordered_run *run = (ordered_run *)(argument);
+	ordered_slot *slot = NULL;
+	/* the writer runs close to the device of the output file */
+	numa_place_writer(run->fd);
+	for (size_t k = 0; k < run->block_count; ++k) {
+		slot = run->slots + (k % run->slot_count);
+		if (wait_for_sequence(&(slot->sequence), 2 * k + 1,
+					&(run->failed)) != 0) {
+			break;
+		}
+		if (write_block(run->fd, run->path, slot->buffer,
+					slot->bytes) != 0) {
+			run->failed = 1;
+			break;
+		}
+		run->written_bytes += slot->bytes;
+		__sync_synchronize();
+		slot->sequence = 2 * (k + run->slot_count);
+	}
+	return (NULL);
+}
+
+/**
+ * A task which generates a fixed-width block directly
+ * into the mapped output file. The encoded symbols are copied
+ * by whole slots, so the last one may overwrite a few bytes
+ * of the next block. These bytes are saved before the block
+ * is generated and restored afterwards. The blocks are generated
+ * in two phases, the even ones first and the odd ones then,
+ * so the next block is never generated at the same time.
+ * Then the pages of the block are written back to the file
+ * and released, so that they do not accumulate in the page cache.
+ *
+ * @param
+ * context	the mapped_run
+ * @param
+ * task_index	the index of the block among the blocks of the phase
+ * @param
+ * worker_index	the index of the worker thread
+ *
+ * @return	If the block has been successfully generated,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int mapped_block_task (void *context,
+		size_t task_index,
+		size_t worker_index) {
+	mapped_run *run = (mapped_run *)(context);
+	const size_t block = 2 * task_index + run->phase;
+	const size_t first = block * run->block_size;
+	const size_t characters = std::min(run->block_size,
+			run->characters - first);
+	char *start = run->mapping + first * run->width;
+	char *end = start + characters * run->width;
+	char *page = run->mapping + (first * run->width) /
+		run->page_size * run->page_size;
+	const size_t length = (size_t)(end - page) +
+		symbol_encoder::slot_size;
+	char head[symbol_encoder::slot_size];
+	size_t bytes = 0;
+	try {
+		rsgen::local_instance()->reseed(block, 0);
+	} catch (std::bad_alloc &) {
+		std::cerr << "output_target: generator allocation error!\n";
+		return (1);
+	}
+	memcpy(head, end, symbol_encoder::slot_size);
+	if (fill_encoded_block(start, characters, *(run->dist),
+				*(run->encoder), run->uniform,
+				run->scale_factor, &bytes) != 0) {
+		return (1);
+	}
+	memcpy(end, head, symbol_encoder::slot_size);
+	numa_note_buffer(worker_index, start);
+	if (msync(page, length, MS_SYNC) == (-1)) {
+		perror(run->path);
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	/* the written pages are neither mapped nor cached any longer */
+	madvise(page, length, MADV_DONTNEED);
+	posix_fadvise(run->fd, (off_t)(page - run->mapping), (off_t)(length),
+			POSIX_FADV_DONTNEED);
+	return (0);
+}
+
+/**
+ * A task which samples a block of the output of the exact size
+ * and counts the bytes it encodes to. The generator is reseeded
+ * by the index of the block, so that the block does not depend
+ * on the thread sampling it.
+ *
+ * @param
+ * context	the exact_run
+ * @param
+ * task_index	the index of the block in the current round
+ * @param
+ * worker_index	the index of the worker thread
+ *
+ * @return	If the block has been successfully sampled,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int exact_sample_task (void *context,
+		size_t task_index,
+		size_t worker_index) {
+	exact_run *run = (exact_run *)(context);
+	exact_block *block = run->blocks + task_index;
+	const unsigned char *lengths = run->encoder->lengths();
+	try {
+		rsgen::local_instance()->reseed(run->first_block + task_index,
+				0);
+	} catch (std::bad_alloc &) {
+		std::cerr << "output_target: generator allocation error!\n";
+		return (1);
+	}
+	if (fill_symbol_indices(block->indices, run->block_size,
+				*(run->dist), run->scale_factor) != 0) {
+		return (1);
+	}
+	block->characters = run->block_size;
+	block->bytes = 0;
+	for (size_t k = 0; k < run->block_size; ++k) {
+		block->bytes += lengths[block->indices[k]];
+	}
+	numa_note_buffer(worker_index, block->indices);
+	return (0);
+}
+
+/**
+ * A task which encodes a block of the output of the exact size
+ * and writes it to its offset in the output file.
+ *
+ * @param
+ * context	the exact_run
+ * @param
+ * task_index	the index of the block
+ * @param
+ * worker_index	the index of the worker thread, unused
+ *
+ * @return	If the block has been successfully encoded and written,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int exact_block_task (void *context,
+		size_t task_index,
+		size_t worker_index) {
+	exact_run *run = (exact_run *)(context);
+	exact_block *block = run->blocks + task_index;
+	size_t bytes = 0;
+	(void)(worker_index);
+	bytes = (size_t)(encode_symbol_indices(block->indices,
+				block->characters, *(run->encoder),
+				block->buffer) - block->buffer);
+	return (pwrite_block(run->fd, run->path, block->buffer, bytes,
+				block->offset));
+}
+
+/**
+ * A task which generates a fixed-width block into the output buffer
+ * of its worker thread and writes it to its offset in the output file,
+ * which is known in advance. The generator is reseeded by the index
+ * of the block, so that the block does not depend on the thread
+ * generating it.
+ *
+ * @param
+ * context	the positioned_run
+ * @param
+ * task_index	the index of the block
+ * @param
+ * worker_index	the index of the worker thread
+ *
+ * @return	If the block has been successfully generated and written,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int positioned_block_task (void *context,
+		size_t task_index,
+		size_t worker_index) {
+	positioned_run *run = (positioned_run *)(context);
+	char *buffer = run->buffers[worker_index];
+	const size_t first = task_index * run->block_size;
+	const size_t characters = std::min(run->block_size,
+			run->characters - first);
+	size_t bytes = 0;
+	try {
+		rsgen::local_instance()->reseed(task_index, 0);
+	} catch (std::bad_alloc &) {
+		std::cerr << "output_target: generator allocation error!\n";
+		return (1);
+	}
+	if (fill_encoded_block(buffer, characters, *(run->dist),
+				*(run->encoder), run->uniform,
+				run->scale_factor, &bytes) != 0) {
+		return (1);
+	}
+	numa_note_buffer(worker_index, buffer);
+	return (pwrite_block(run->fd, run->path, buffer, bytes,
+				first * run->encoder->fixed_length()));
+}
+
+/* member functions */
+
+output_target::output_target () :
+		internal_character_encoding(NULL),
+		fd(-1),
+		cd((iconv_t)(-1)),
+		encoder_retval(0),
+		encoded_dist(NULL),
+		uniform(0),
+		block_size(0),
+		wbuffer(NULL),
+		buffer(NULL),
+		buffer_size(0),
+		block_bytes(0),
+		total_bytes(0) {
+}
+
+output_target::~output_target () {
+	close();
+	delete[] wbuffer;
+	delete[] buffer;
+}
+
+/**
+ * A member function which opens the output file
+ * and prepares the character conversion.
+ *
+ * @param
+ * filename	the name of the output file
+ * @param
+ * encoding	the character encoding of the output file
+ * @param
+ * internal_character_encoding	the encoding of the wchar_t characters
+ * @param
+ * block_size	the maximum number of characters of a block
+ *
+ * @return	If the output file has been successfully opened,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int output_target::open (const char *filename,
+		const char *encoding,
+		const char *internal_character_encoding,
+		size_t block_size) {
+	path = filename;
+	target_encoding = encoding;
+	this->internal_character_encoding = internal_character_encoding;
+	this->block_size = block_size;
+	fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC,
+			S_IRUSR | S_IWUSR |
+			S_IRGRP | S_IWGRP |
+			S_IROTH | S_IWOTH);
+	if (fd == (-1)) {
+		perror(filename);
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	if ((cd = iconv_open(encoding, internal_character_encoding)) ==
+			(iconv_t)(-1)) {
+		perror("output_target: iconv_open");
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	try {
+		wbuffer = new wchar_t[block_size];
+	} catch (std::bad_alloc &) {
+		std::cerr << "output_target: wbuffer allocation error!\n";
+		return (1);
+	}
+	/*
+	 * we suppose that the maximum number of bytes that encode
+	 * a single UTF-8 character can never exceed 6
+	 */
+	return (reserve(block_size * 6));
+}
+
+/**
+ * A member function which makes sure that the output buffer
+ * can hold at least the specified number of bytes.
+ *
+ * @param
+ * size		the required size of the output buffer
+ *
+ * @return	If the output buffer is large enough,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int output_target::reserve (size_t size) {
+	if (size <= buffer_size) {
+		return (0);
+	}
+	delete[] buffer;
+	buffer = NULL;
+	buffer_size = 0;
+	try {
+		buffer = new char[size];
+	} catch (std::bad_alloc &) {
+		std::cerr << "output_target: buffer allocation error!\n";
+		return (1);
+	}
+	buffer_size = size;
+	return (0);
+}
+
+/**
+ * A member function which prepares the encoding of the symbols
+ * of the distribution, unless it has already been prepared.
+ * Once the symbols can not be encoded by the symbol encoder,
+ * the iconv is used for the rest of the output.
+ *
+ * @param
+ * dist		the distribution of the next blocks
+ *
+ * @return	If the encoding has been successfully prepared,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int output_target::prepare (const distribution &dist) {
+	if ((&dist == encoded_dist) ||
+			((encoded_dist != NULL) && (encoder_retval != 0))) {
+		return (0);
+	}
+	/* encoding the symbols once instead of every generated character */
+	encoder_retval = encoder.build(dist, target_encoding.c_str(),
+			internal_character_encoding);
+	if (encoder_retval > 0) {
+		return (1);
+	}
+	encoded_dist = &dist;
+	/*
+	 * the symbols of a small uniform distribution are picked
+	 * by the random bytes directly, whatever their encoding is
+	 */
+	uniform = ((encoder_retval == 0) && (uniform_sampling(dist) != 0)) ?
+		1 : 0;
+	/* the encoded symbols are copied by whole slots */
+	if (encoder_retval == 0) {
+		return (reserve(block_size * encoder.max_length() +
+					symbol_encoder::slot_size));
+	}
+	return (0);
+}
+
+/**
+ * A member function which generates the block
+ * of pseudorandom characters directly into the output buffer.
+ *
+ * @param
+ * dist		the distribution prepared by the prepare member function
+ * @param
+ * characters	the number of characters of the block
+ * @param
+ * scale_factor	the factor used to scale the pseudorandom numbers
+ * 		to the total number of occurrences
+ *
+ * @return	If the block has been successfully generated,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int output_target::generate (const distribution &dist,
+		size_t characters,
+		double scale_factor) {
+	if (encoder_retval == 0) {
+		if (fill_encoded_block(buffer, characters, dist, encoder,
+					uniform, scale_factor,
+					&block_bytes) != 0) {
+			return (1);
+		}
+	} else {
+		if (fill_output_wbuffer(wbuffer, characters,
+					dist, scale_factor) != 0) {
+			return (1);
+		}
+		if (convert_from_wbuffer(&cd, wbuffer, buffer, characters,
+					buffer_size, &block_bytes) != 0) {
+			return (1);
+		}
+	}
+	return (0);
+}
+
+/**
+ * A member function which encodes the block
+ * of the symbol indices into the output buffer.
+ *
+ * @param
+ * dist		the distribution prepared by the prepare member function
+ * @param
+ * indices	the indices of the symbols of the distribution
+ * @param
+ * characters	the number of characters of the block
+ *
+ * @return	If the block has been successfully encoded,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int output_target::encode (const distribution &dist,
+		const uint32_t *indices,
+		size_t characters) {
+	const uint32_t *symbols = dist.symbols();
+	if (encoder_retval == 0) {
+		block_bytes = (size_t)(encode_symbol_indices(indices,
+					characters, encoder, buffer) - buffer);
+		return (0);
+	}
+	for (size_t i = 0; i < characters; ++i) {
+		wbuffer[i] = (wchar_t)(symbols[indices[i]]);
+	}
+	if (convert_from_wbuffer(&cd, wbuffer, buffer, characters,
+				buffer_size, &block_bytes) != 0) {
+		return (1);
+	}
+	return (0);
+}
+
+/**
+ * A member function which writes the encoded block to the output file.
+ *
+ * @return	If the block has been successfully written,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int output_target::flush () {
+	if (write_block(fd, path.c_str(), buffer, block_bytes) != 0) {
+		return (1);
+	}
+	total_bytes += block_bytes;
+	block_bytes = 0;
+	return (0);
+}
+
+/**
+ * A member function which prepares the output to continue
+ * the output file at the specified character, as if all the characters
+ * preceding it had been written. If the symbols are encoded
+ * by the iconv, the character preceding it is generated again
+ * and converted, so that the conversion state, like the emitted
+ * byte order mark or the shift state, is the one of the output file
+ * at this point. The converted bytes are discarded.
+ *
+ * @param
+ * dist		the distribution prepared by the prepare member function
+ * @param
+ * scale_factor	the factor used to scale the pseudorandom numbers
+ * 		to the total number of occurrences
+ * @param
+ * first	the index of the first character to write next
+ *
+ * @return	If the output has been successfully prepared,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int output_target::resume (const distribution &dist,
+		double scale_factor,
+		size_t first) {
+	/* the number of characters of the block up to the preceding one */
+	const size_t characters = (first - 1) % block_size + 1;
+	size_t bytes = 0;
+	if ((encoder_retval == 0) || (first == 0)) {
+		return (0);
+	}
+	rsgen::get_instance()->reseed((first - 1) / block_size, 0);
+	if ((fill_output_wbuffer(wbuffer, characters, dist,
+					scale_factor) != 0) ||
+			(convert_from_wbuffer(&cd, wbuffer + characters - 1,
+					buffer, 1, buffer_size,
+					&bytes) != 0)) {
+		return (1);
+	}
+	return (0);
+}
+
+/**
+ * A member function which generates the specified number of characters
+ * of the output file starting at the specified one on several threads.
+ * The blocks are generated into the slots of a ring,
+ * which are written in the order of the blocks by a writer thread.
+ * The block k may only use its slot once the writer thread
+ * has written the block, which has used the slot before it.
+ * Every block is generated by the generator reseeded
+ * by its index, so the output does not depend
+ * on the number of threads. Even a single generating thread
+ * does not wait for the writes, as long as there is a free slot.
+ *
+ * The iconv conversion state is kept from one block to the next,
+ * so if the symbols are encoded by the iconv, the blocks
+ * are generated in order by the calling thread alone.
+ *
+ * @param
+ * dist		the distribution prepared by the prepare member function
+ * @param
+ * scale_factor	the factor used to scale the pseudorandom numbers
+ * 		to the total number of occurrences
+ * @param
+ * first	the index of the first character to generate,
+ * 		zero for the whole output file
+ * @param
+ * characters	the number of characters to generate
+ * @param
+ * thread_count	the number of threads generating the blocks
+ * @param
+ * buffer_count	the number of slots of the ring per generating thread,
+ * 		at least two
+ *
+ * @return	If the output file has been successfully generated,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int output_target::generate_ordered (const distribution &dist,
+		double scale_factor,
+		size_t first,
+		size_t characters,
+		size_t thread_count,
+		size_t buffer_count) {
+	const size_t block_count = (first + characters + block_size - 1) /
+		block_size - first / block_size;
+	ordered_run run;
+	pthread_t writer;
+	size_t i = 0;
+	int pthread_retval = 0;
+	int retval = 0;
+	if ((encoder_retval != 0) || (thread_count == 0)) {
+		thread_count = 1;
+	}
+	run.fd = fd;
+	run.path = path.c_str();
+	run.cd = (encoder_retval != 0) ? &cd : NULL;
+	run.wbuffer = wbuffer;
+	/* the encoded symbols are copied by whole slots */
+	run.slot_buffer_size = (encoder_retval != 0) ? buffer_size :
+		block_size * encoder.max_length() + symbol_encoder::slot_size;
+	run.encoder = &encoder;
+	run.dist = &dist;
+	run.uniform = uniform;
+	run.scale_factor = scale_factor;
+	run.block_size = block_size;
+	run.first = first;
+	run.characters = characters;
+	run.block_count = block_count;
+	/* every thread may generate a block while the others wait */
+	run.slot_count = std::max(buffer_count, (size_t)(2)) * thread_count;
+	run.slots = NULL;
+	run.written_bytes = 0;
+	run.failed = 0;
+	try {
+		run.slots = new ordered_slot[run.slot_count];
+		for (i = 0; i < run.slot_count; ++i) {
+			run.slots[i].buffer = NULL;
+			run.slots[i].bytes = 0;
+			run.slots[i].sequence = 2 * i;
+		}
+		/*
+		 * the tasks are dealt to the workers in turns, so every
+		 * slot is mostly filled by the same worker, which touches
+		 * its pages first and thus places them on its node
+		 */
+		for (i = 0; i < run.slot_count; ++i) {
+			run.slots[i].buffer = new char[run.slot_buffer_size];
+		}
+	} catch (std::bad_alloc &) {
+		std::cerr << "output_target: slot allocation error!\n";
+		retval = 1;
+	}
+	if (retval == 0) {
+		pthread_retval = pthread_create(&writer, NULL,
+				ordered_writer_main, &run);
+		if (pthread_retval != 0) {
+			std::cerr << "output_target: pthread_create: " <<
+				strerror(pthread_retval) << "\n";
+			retval = 1;
+		}
+	}
+	if (retval == 0) {
+		if (run_parallel(ordered_block_task, &run, block_count,
+					thread_count) != 0) {
+			run.failed = 1;
+		}
+		pthread_join(writer, NULL);
+		if (run.failed != 0) {
+			retval = 1;
+		}
+		total_bytes += run.written_bytes;
+	}
+	for (i = 0; (run.slots != NULL) && (i < run.slot_count); ++i) {
+		delete[] run.slots[i].buffer;
+	}
+	delete[] run.slots;
+	return (retval);
+}
+
+/**
+ * A member function which generates the output file
+ * of the specified number of characters on several threads,
+ * if every character is encoded in the same number of bytes.
+ * The output file is sized up front and every thread writes
+ * the blocks it generates directly to their offsets,
+ * without any writer thread. Every block is generated
+ * by the generator reseeded by its index, so the output
+ * is the same as the one of the generate_ordered member function.
+ *
+ * @param
+ * dist		the distribution prepared by the prepare member function
+ * @param
+ * scale_factor	the factor used to scale the pseudorandom numbers
+ * 		to the total number of occurrences
+ * @param
+ * characters	the number of characters of the output file
+ * @param
+ * thread_count	the number of threads generating the blocks
+ *
+ * @return	If the output file has been successfully generated,
+ * 		this function returns zero.
+ * 		If the characters are not of a fixed width, or if the output
+ * 		file is not a regular file, nothing is generated
+ * 		and this function returns (-1).
+ * 		Otherwise, it returns one (1).
+ */
+int output_target::generate_positioned (const distribution &dist,
+		double scale_factor,
+		size_t characters,
+		size_t thread_count) {
+	const size_t block_count = (characters + block_size - 1) / block_size;
+	const size_t width = (encoder_retval == 0) ?
+		encoder.fixed_length() : 0;
+	struct stat output_stat;
+	positioned_run run;
+	size_t i = 0;
+	int retval = 0;
+	if ((width == 0) || (fstat(fd, &output_stat) == (-1)) ||
+			(!S_ISREG(output_stat.st_mode))) {
+		/* resetting the errno */
+		errno = 0;
+		return (-1);
+	}
+	if (ftruncate(fd, (off_t)(characters * width)) == (-1)) {
+		perror(path.c_str());
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	if (thread_count == 0) {
+		thread_count = 1;
+	}
+	run.fd = fd;
+	run.path = path.c_str();
+	run.encoder = &encoder;
+	run.dist = &dist;
+	run.uniform = uniform;
+	run.scale_factor = scale_factor;
+	run.block_size = block_size;
+	run.characters = characters;
+	run.buffers = NULL;
+	try {
+		run.buffers = new char *[thread_count];
+		for (i = 0; i < thread_count; ++i) {
+			run.buffers[i] = NULL;
+		}
+		/* the encoded symbols are copied by whole slots */
+		for (i = 0; i < thread_count; ++i) {
+			run.buffers[i] = new char[block_size * width +
+				symbol_encoder::slot_size];
+		}
+	} catch (std::bad_alloc &) {
+		std::cerr << "output_target: buffer allocation error!\n";
+		retval = 1;
+	}
+	if ((retval == 0) && (run_parallel(positioned_block_task, &run,
+					block_count, thread_count) != 0)) {
+		retval = 1;
+	}
+	if (retval == 0) {
+		total_bytes += characters * width;
+	}
+	for (i = 0; (run.buffers != NULL) && (i < thread_count); ++i) {
+		delete[] run.buffers[i];
+	}
+	delete[] run.buffers;
+	return (retval);
+}
+
+/**
+ * A member function which generates the output file
+ * of the specified number of characters directly
+ * into its memory mapping on several threads, if every character
+ * is encoded in the same number of bytes. There is neither
+ * any output buffer, nor any write system call. Every block
+ * is generated by the generator reseeded by its index,
+ * so the output is the same as the one of the generate_ordered
+ * member function.
+ *
+ * @param
+ * dist		the distribution prepared by the prepare member function
+ * @param
+ * scale_factor	the factor used to scale the pseudorandom numbers
+ * 		to the total number of occurrences
+ * @param
+ * characters	the number of characters of the output file
+ * @param
+ * thread_count	the number of threads generating the blocks
+ *
+ * @return	If the output file has been successfully generated,
+ * 		this function returns zero.
+ * 		If the characters are not of a fixed width, or if the output
+ * 		file is not a regular file, nothing is generated
+ * 		and this function returns (-1).
+ * 		Otherwise, it returns one (1).
+ */
+int output_target::generate_mapped (const distribution &dist,
+		double scale_factor,
+		size_t characters,
+		size_t thread_count) {
+	const size_t block_count = (characters + block_size - 1) / block_size;
+	const size_t width = (encoder_retval == 0) ?
+		encoder.fixed_length() : 0;
+	const size_t output_size = characters * width;
+	/* the last encoded symbol may overwrite the spare bytes */
+	const size_t mapping_size = output_size + symbol_encoder::slot_size;
+	struct stat output_stat;
+	mapped_run run;
+	void *mapping = MAP_FAILED;
+	int mapped_fd = (-1);
+	int retval = 0;
+	if ((width == 0) || (fstat(fd, &output_stat) == (-1)) ||
+			(!S_ISREG(output_stat.st_mode))) {
+		/* resetting the errno */
+		errno = 0;
+		return (-1);
+	}
+	/* the shared mapping needs the file to be opened for reading */
+	if (((mapped_fd = ::open(path.c_str(), O_RDWR)) == (-1)) ||
+			(ftruncate(mapped_fd, (off_t)(mapping_size)) == (-1)) ||
+			((mapping = mmap(NULL, mapping_size,
+					PROT_READ | PROT_WRITE, MAP_SHARED,
+					mapped_fd, 0)) == MAP_FAILED)) {
+		perror(path.c_str());
+		/* resetting the errno */
+		errno = 0;
+		retval = 1;
+	}
+	if (retval == 0) {
+		madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+		run.fd = mapped_fd;
+		run.path = path.c_str();
+		run.mapping = (char *)(mapping);
+		run.page_size = (size_t)(sysconf(_SC_PAGESIZE));
+		run.width = width;
+		run.encoder = &encoder;
+		run.dist = &dist;
+		run.uniform = uniform;
+		run.scale_factor = scale_factor;
+		run.block_size = block_size;
+		run.characters = characters;
+		for (run.phase = 0; (retval == 0) && (run.phase < 2);
+				++run.phase) {
+			if (run_parallel(mapped_block_task, &run,
+					(block_count + 1 - run.phase) / 2,
+					thread_count) != 0) {
+				retval = 1;
+			}
+		}
+	}
+	if ((mapping != MAP_FAILED) &&
+			(munmap(mapping, mapping_size) == (-1))) {
+		perror(path.c_str());
+		/* resetting the errno */
+		errno = 0;
+		retval = 1;
+	}
+	/* removing the spare bytes */
+	if ((mapped_fd != (-1)) &&
+			((ftruncate(mapped_fd, (off_t)(output_size)) == (-1)) ||
+			 (::close(mapped_fd) == (-1)))) {
+		perror(path.c_str());
+		/* resetting the errno */
+		errno = 0;
+		retval = 1;
+	}
+	if (retval == 0) {
+		total_bytes += output_size;
+	}
+	return (retval);
+}
+
+/**
+ * A member function which generates the output file
+ * of exactly the specified number of bytes. The blocks
+ * are sampled in rounds of one block per thread. The numbers
+ * of bytes the blocks encode to are summed into their offsets,
+ * so that the threads encode the blocks and write them
+ * to their offsets independently. The block reaching
+ * the end of the output file is adjusted to end exactly there
+ * and the blocks sampled after it are discarded. Every block
+ * is sampled by the generator reseeded by its index,
+ * so the output does not depend on the number of threads.
+ *
+ * @param
+ * dist		the distribution prepared by the prepare member function
+ * @param
+ * scale_factor	the factor used to scale the pseudorandom numbers
+ * 		to the total number of occurrences
+ * @param
+ * output_bytes	the number of bytes of the output file
+ * @param
+ * thread_count	the maximum number of threads to use
+ * @param
+ * characters	when this function returns, this variable
+ * 		will be set to the number of generated characters
+ *
+ * @return	If the output file has been successfully generated,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int output_target::generate_exact (const distribution &dist,
+		double scale_factor,
+		size_t output_bytes,
+		size_t thread_count,
+		size_t *characters) {
+	/* the adjusted block may grow by a few characters */
+	const size_t capacity = block_size + symbol_encoder::reachable_limit +
+		symbol_encoder::slot_size;
+	const size_t block_count = (thread_count > 0) ? thread_count : 1;
+	exact_block *blocks = NULL;
+	exact_run run;
+	size_t round_count = 0;
+	size_t round_bytes = 0;
+	size_t remaining = 0;
+	size_t sampled_count = 0;
+	size_t i = 0;
+	int retval = 0;
+	(*characters) = 0;
+	if (encoder_retval != 0) {
+		std::cerr << "The exact output size requires "
+			"a stateless output encoding!\n";
+		return (1);
+	}
+	if (encoder.reachable(output_bytes) == 0) {
+		std::cerr << "The exact size of " << output_bytes <<
+			" bytes can not be reached\n"
+			"by the encoded characters!\n";
+		return (1);
+	}
+	try {
+		blocks = new exact_block[block_count];
+		for (i = 0; i < block_count; ++i) {
+			blocks[i].indices = NULL;
+			blocks[i].buffer = NULL;
+		}
+		for (i = 0; i < block_count; ++i) {
+			blocks[i].indices = new uint32_t[capacity];
+			blocks[i].buffer = new char[capacity *
+				encoder.max_length() +
+				symbol_encoder::slot_size];
+		}
+	} catch (std::bad_alloc &) {
+		std::cerr << "output_target: block allocation error!\n";
+		retval = 1;
+	}
+	run.fd = fd;
+	run.path = path.c_str();
+	run.encoder = &encoder;
+	run.dist = &dist;
+	run.scale_factor = scale_factor;
+	run.block_size = block_size;
+	run.first_block = 0;
+	run.blocks = blocks;
+	while ((retval == 0) && (total_bytes < output_bytes)) {
+		/*
+		 * every character takes at least a byte, so no more blocks
+		 * than these can be needed to reach the end
+		 */
+		sampled_count = (output_bytes - total_bytes) / block_size + 2;
+		if (sampled_count > block_count) {
+			sampled_count = block_count;
+		}
+		if (run_parallel(exact_sample_task, &run, sampled_count,
+					thread_count) != 0) {
+			retval = 1;
+			break;
+		}
+		round_bytes = 0;
+		for (round_count = 0; (round_count < sampled_count) &&
+				(total_bytes + round_bytes < output_bytes);
+				++round_count) {
+			exact_block &block = blocks[round_count];
+			remaining = output_bytes - total_bytes - round_bytes;
+			/*
+			 * the block either passes the end, or it would leave
+			 * too few bytes to be sure they can be filled
+			 */
+			if ((block.bytes > remaining) ||
+					(remaining - block.bytes <=
+					 symbol_encoder::reachable_limit)) {
+				/* the tail is resampled by a separate stream */
+				rsgen::get_instance()->reseed(run.first_block +
+						round_count, 1);
+				if (fill_exact_tail(block.indices,
+						&(block.characters),
+						&(block.bytes), remaining,
+						dist, encoder,
+						scale_factor) != 0) {
+					retval = 1;
+					break;
+				}
+			}
+			/* the exclusive prefix sum of the block sizes */
+			block.offset = total_bytes + round_bytes;
+			round_bytes += block.bytes;
+			(*characters) += block.characters;
+		}
+		if ((retval == 0) && (run_parallel(exact_block_task, &run,
+					round_count, thread_count) != 0)) {
+			retval = 1;
+		}
+		total_bytes += round_bytes;
+		run.first_block += round_count;
+	}
+	for (i = 0; (blocks != NULL) && (i < block_count); ++i) {
+		delete[] blocks[i].indices;
+		delete[] blocks[i].buffer;
+	}
+	delete[] blocks;
+	return (retval);
+}
+
+/**
+ * A member function which closes the output file.
+ *
+ * @return	If the output file has been successfully closed,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+int output_target::close () {
+	int retval = 0;
+	if ((cd != (iconv_t)(-1)) && (iconv_close(cd) == (-1))) {
+		perror("output_target: iconv_close");
+		/* resetting the errno */
+		errno = 0;
+		retval = 1;
+	}
+	cd = (iconv_t)(-1);
+	if ((fd != (-1)) && (::close(fd) == (-1))) {
+		perror(path.c_str());
+		/* resetting the errno */
+		errno = 0;
+		retval = 1;
+	}
+	fd = (-1);
+	return (retval);
+}
+
+/**
+ * @return	This function returns the name of the output file.
+ */
+const char *output_target::filename () const {
+	return (path.c_str());
+}
+
+/**
+ * @return	This function returns the character encoding
+ * 		of the output file.
+ */
+const char *output_target::encoding () const {
+	return (target_encoding.c_str());
+}
+
+/**
+ * @return	This function returns the description of the way
+ * 		the generated characters are encoded.
+ */
+const char *output_target::kernel () const {
+	if (encoder_retval != 0) {
+		return ("iconv");
+	} else if (uniform != 0) {
+		return ("uniform random bytes");
+	}
+	return (encoder.kernel());
+}
+
+/**
+ * @return	This function returns the number of bytes
+ * 		written to the output file.
+ */
+size_t output_target::bytes_written () const {
+	return (total_bytes);
+}
+
+/* functions */
+
+/**
+ * A function which parses the output specification
+ * of the form encoding:filename.
+ *
+ * @param
+ * specification	the argument of the -e parameter
+ * @param
+ * encoding	when this function returns, this variable
+ * 		will be set to the character encoding
+ * @param
+ * filename	when this function returns, this variable
+ * 		will be set to the name of the output file
+ *
+ * @return	If the argument is an output specification,
+ * 		this function returns zero.
+ * 		If it is just a character encoding, it returns (-1).
+ * 		If either of its parts is empty, it returns one (1).
+ */
+int parse_output_specification (const char *specification,
+		std::string &encoding,
+		std::string &filename) {
+	/* the encoding names do not contain colons, the file names may */
+	const char *colon = strchr(specification, ':');
+	if (colon == NULL) {
+		return (-1);
+	}
+	encoding.assign(specification, (size_t)(colon - specification));
+	filename.assign(colon + 1);
+	if (encoding.empty() || filename.empty()) {
+		return (1);
+	}
+	return (0);
+}
+
+/**
+ * A task which encodes the block of symbol indices
+ * to a single output file and writes it.
+ *
+ * @param
+ * context	the output_encoding_run
+ * @param
+ * task_index	the index of the output file
+ * @param
+ * worker_index	the index of the worker thread, unused
+ *
+ * @return	If the block has been successfully encoded and written,
+ * 		this function returns zero.
+ * 		Otherwise, it returns one (1).
+ */
+static int encode_output_task (void *context,
+		size_t task_index,
+		size_t worker_index) {
+	output_encoding_run *run = (output_encoding_run *)(context);
+	output_target *target = (*(run->targets))[task_index];
+	(void)(worker_index);
+	if ((target->encode(*(run->dist), run->indices,
+				run->characters) != 0) ||
+			(target->flush() != 0)) {
+		return (1);
+	}
+	return (0);
+}
+
+/**
+ * A function which encodes the same block of symbol indices
+ * to all the output files in parallel and writes them,
+ * so that all the output files contain the same characters.
+ *
+ * @param
+ * targets	the output files, prepared for the distribution
+ * @param
+ * dist		the distribution
+ * @param
+ * indices	the indices of the symbols of the distribution
+ * @param
+ * characters	the number of characters of the block
+ * @param
+ * thread_count	the maximum number of threads to use
+ *
+ * @return	If the block has been successfully encoded
+ * 		and written to all the output files,
+ * 		this function returns zero.
+ * 		Otherwise, it returns a nonzero error number.
+ */
+int encode_output_targets (output_target_list &targets,
+		const distribution &dist,
+		const uint32_t *indices,
+		size_t characters,
+		size_t thread_count) {
+	output_encoding_run run;
+	run.targets = &targets;
+	run.dist = &dist;
+	run.indices = indices;
+	run.characters = characters;
+	return (run_parallel(encode_output_task, &run,
+				targets.size(), thread_count));
+}
@@ -0,0 +1,387 @@
+/*
+ * Copyright 2012 Peter Bašista
+ *
+ * This file is part of rsgen
+ *
+ * rsgen is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * The pseudorandom string generator parallel execution functions.
+ * This file contains the implementation of functions,
+ * which are used to run independent tasks on several threads
+ * and to report how busy the threads have been.
+ */
+
+#include "parallel.h"
+#include "numa.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <pthread.h>
+#include <unistd.h>
+
+/* auxiliary structures */
+
+/*
+ * The tasks of a single worker. The worker w of the run
+ * with T workers owns the tasks w, w + T, w + 2T and so on,
+ * which are represented by their positions in this sequence.
+ * The owner takes the tasks from the front, while the other
+ * workers steal them from the back.
+ */
+struct parallel_deque {
+	pthread_mutex_t mutex;
+	/* the position of the first task left */
+	size_t front;
+	/* the position following the last task left */
+	size_t back;
+	/*
+	 * nonzero if the owner is running, otherwise the tasks
+	 * are stolen from the front, so that they are still taken
+	 * in their increasing order
+	 */
+	int started;
+};
+
+/*
+ * the state shared by all the threads executing
+ * a single call to the run_parallel function
+ */
+struct parallel_run {
+	parallel_task task;
+	void *context;
+	size_t task_count;
+	size_t thread_count;
+	parallel_deque *deques;
+	/* the first nonzero value returned by any of the tasks */
+	volatile int retval;
+};
+
+/* the arguments of a single worker thread */
+struct parallel_worker {
+	parallel_run *run;
+	size_t worker_index;
+	size_t tasks;
+	size_t stolen_tasks;
+	/* the time spent executing the tasks, in microseconds */
+	unsigned long busy;
+};
+
+/*
+ * the utilisation accumulated over all the runs,
+ * the times are in microseconds
+ */
+struct parallel_record {
+	size_t tasks;
+	size_t stolen_tasks;
+	unsigned long busy;
+	unsigned long available;
+};
+
+/* global variables */
+
+/* the utilisation of the workers of all the runs by their indices */
+static parallel_record parallel_records[parallel_recorded_workers];
+
+/* static functions */
+
+/**
+ * A function which returns the monotonic time in microseconds.
+ *
+ * @return	This function returns the current monotonic time.
+ */
+static unsigned long parallel_clock () {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((unsigned long)(now.tv_sec) * 1000000UL +
+			(unsigned long)(now.tv_nsec / 1000));
+}
+
+/**
+ * A function which takes a task from the deque.
+ *
+ * @param
+ * deque	the deque of the tasks
+ * @param
+ * from_back	nonzero if the task should be taken from the back
+ * 		of the deque of a running owner
+ * @param
+ * position	if a task has been taken, this variable
+ * 		will be set to its position in the deque
+ *
+ * @return	If a task has been taken, this function returns one (1).
+ * 		If the deque is empty, it returns zero.
+ */
+static int take_task (parallel_deque *deque,
+		int from_back,
+		size_t *position) {
+	int taken = 0;
+	pthread_mutex_lock(&(deque->mutex));
+	if (deque->front < deque->back) {
+		if ((from_back != 0) && (deque->started != 0)) {
+			(*position) = --(deque->back);
+		} else {
+			(*position) = (deque->front)++;
+		}
+		taken = 1;
+	}
+	pthread_mutex_unlock(&(deque->mutex));
+	return (taken);
+}
+
+/**
+ * A function executed by each of the worker threads.
+ * It repeatedly takes the next task of its own deque
+ * and executes it. Once its own deque is empty, it steals
+ * the tasks of the other workers, until there are no more
+ * tasks left, or until any of the tasks fails.
+ *
+ * @param
+ * argument	a pointer to the parallel_worker structure
+ *
+ * @return	This function always returns NULL.
+ */
+static void *parallel_worker_main (void *argument) {
+	parallel_worker *worker = (parallel_worker *)(argument);
+	parallel_run *run = worker->run;
+	size_t owner = worker->worker_index;
+	size_t position = 0;
+	size_t i = 0;
+	unsigned long started = 0;
+	int retval = 0;
+	numa_place_worker(worker->worker_index, run->thread_count);
+	/* no more tasks are started once any of them has failed */
+	while (run->retval == 0) {
+		if (take_task(run->deques + worker->worker_index, 0,
+					&position) != 0) {
+			owner = worker->worker_index;
+		} else {
+			for (i = 1; i < run->thread_count; ++i) {
+				owner = (worker->worker_index + i) %
+					run->thread_count;
+				if (take_task(run->deques + owner, 1,
+							&position) != 0) {
+					++(worker->stolen_tasks);
+					break;
+				}
+			}
+			if (i >= run->thread_count) {
+				break;
+			}
+		}
+		started = parallel_clock();
+		retval = run->task(run->context,
+				owner + position * run->thread_count,
+				worker->worker_index);
+		worker->busy += parallel_clock() - started;
+		++(worker->tasks);
+		if (retval != 0) {
+			__sync_bool_compare_and_swap(&(run->retval),
+					0, retval);
+		}
+	}
+	return (NULL);
+}
+
+/**
+ * A function which adds the utilisation of the worker
+ * to the utilisation of all the workers with its index.
+ *
+ * @param
+ * worker	the worker
+ * @param
+ * available	the duration of the run in microseconds
+ */
+static void record_utilisation (const parallel_worker &worker,
+		unsigned long available) {
+	parallel_record *record = NULL;
+	if (worker.worker_index >= parallel_recorded_workers) {
+		return;
+	}
+	/* the runs may be nested, so the records are updated atomically */
+	record = parallel_records + worker.worker_index;
+	__sync_fetch_and_add(&(record->tasks), worker.tasks);
+	__sync_fetch_and_add(&(record->stolen_tasks), worker.stolen_tasks);
+	__sync_fetch_and_add(&(record->busy), worker.busy);
+	__sync_fetch_and_add(&(record->available), available);
+}
+
+/* regular functions */
+
+/**
+ * A function which determines the number of processors
+ * available to this process.
+ *
+ * @return	This function returns the number of online processors,
+ * 		or one (1) if it could not have been determined.
+ */
+size_t available_processors () {
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	if (processors < 1) {
+		/* resetting the errno */
+		errno = 0;
+		return (1);
+	}
+	return ((size_t)(processors));
+}
+
+/**
+ * A function which returns the utilisation of the worker threads
+ * accumulated over all the calls to the run_parallel function.
+ *
+ * @param
+ * statistics	the array, which will be filled by the utilisation
+ * 		of the workers by their indices
+ * @param
+ * count	the number of elements of the array
+ *
+ * @return	This function returns the number of the worker indices,
+ * 		which have taken part in any of the runs,
+ * 		but at most 'count'.
+ */
+size_t parallel_utilisation (parallel_statistics *statistics, size_t count) {
+	size_t used = 0;
+	for (size_t i = 0; (i < count) && (i < parallel_recorded_workers);
+			++i) {
+		statistics[i].tasks = parallel_records[i].tasks;
+		statistics[i].stolen_tasks = parallel_records[i].stolen_tasks;
+		statistics[i].busy_seconds =
+			(double)(parallel_records[i].busy) / 1e6;
+		statistics[i].available_seconds =
+			(double)(parallel_records[i].available) / 1e6;
+		if (parallel_records[i].available > 0) {
+			used = i + 1;
+		}
+	}
+	return (used);
+}
+
+/**
+ * A function which executes the 'task_count' tasks
+ * on at most 'thread_count' threads, including the calling thread.
+ * Every thread owns a deque of the tasks, which are initially
+ * dealt to the threads in turns, so that the tasks are started
+ * roughly in the increasing order of their indices,
+ * but they may finish in any order. A thread, which has finished
+ * its own tasks, steals the tasks of the others, so no thread stays
+ * idle while the tasks of different costs are left. If there is
+ * only a single task or a single thread, all the tasks are executed
+ * by the calling thread as the worker zero.
+ * Once a task fails, no more tasks are started.
+ *
+ * @param
+ * task		the function executing a single task
+ * @param
+ * context	the context shared by all the tasks
+ * @param
+ * task_count	the number of tasks to execute
+ * @param
+ * thread_count	the maximum number of threads to use
+ *
+ * @return	If all the tasks have been successfully executed,
+ * 		this function returns zero.
+ * 		Otherwise, the first nonzero value returned by a task,
+ * 		or (-1) in case of an allocation error, is returned.
+ */
+int run_parallel (parallel_task task,
+		void *context,
+		size_t task_count,
+		size_t thread_count) {
+	parallel_run run;
+	parallel_worker *workers = NULL;
+	parallel_deque *deques = NULL;
+	pthread_t *threads = NULL;
+	/* the affinity of the calling thread, which is the worker zero */
+	numa_affinity affinity;
+	size_t i = 0;
+	size_t started_threads = 0;
+	unsigned long started = parallel_clock();
+	int pthread_retval = 0;
+	int retval = 0;
+	if (thread_count > task_count) {
+		thread_count = task_count;
+	}
+	if (thread_count == 0) {
+		thread_count = 1;
+	}
+	try {
+		workers = new parallel_worker[thread_count];
+		deques = new parallel_deque[thread_count];
+		threads = new pthread_t[thread_count];
+	} catch (std::bad_alloc &) {
+		std::cerr << "run_parallel: allocation error!\n";
+		delete[] workers;
+		delete[] deques;
+		return (-1);
+	}
+	run.task = task;
+	run.context = context;
+	run.task_count = task_count;
+	run.thread_count = thread_count;
+	run.deques = deques;
+	run.retval = 0;
+	for (i = 0; i < thread_count; ++i) {
+		workers[i].run = &run;
+		workers[i].worker_index = i;
+		workers[i].tasks = 0;
+		workers[i].stolen_tasks = 0;
+		workers[i].busy = 0;
+		pthread_mutex_init(&(deques[i].mutex), NULL);
+		deques[i].front = 0;
+		deques[i].back = (task_count + thread_count - 1 - i) /
+			thread_count;
+		deques[i].started = (i == 0) ? 1 : 0;
+	}
+	/* the calling thread itself acts as the worker zero */
+	for (i = 1; i < thread_count; ++i) {
+		pthread_retval = pthread_create(&(threads[i]), NULL,
+				parallel_worker_main, &(workers[i]));
+		if (pthread_retval != 0) {
+			/*
+			 * the tasks will still be executed
+			 * by the threads started so far
+			 */
+			std::cerr << "Warning: run_parallel: "
+				"pthread_create: " <<
+				strerror(pthread_retval) << "\n";
+			break;
+		}
+		pthread_mutex_lock(&(deques[i].mutex));
+		deques[i].started = 1;
+		pthread_mutex_unlock(&(deques[i].mutex));
+		++started_threads;
+	}
+	numa_save_affinity(affinity);
+	parallel_worker_main(&(workers[0]));
+	numa_restore_affinity(affinity);
+	for (i = 1; i <= started_threads; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+	for (i = 0; i <= started_threads; ++i) {
+		record_utilisation(workers[i], parallel_clock() - started);
+	}
+	for (i = 0; i < thread_count; ++i) {
+		pthread_mutex_destroy(&(deques[i].mutex));
+	}
+	retval = run.retval;
+	delete[] threads;
+	delete[] deques;
+	delete[] workers;
+	return (retval);
+}
@@ -0,0 +1,66 @@
+#!/bin/sh
+# Copyright 2012 Peter Bašista
+#
+# This file is part of the rsgen
+#
+# rsgen is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Checks that the corpus without any ASCII characters is sampled
+# in the multi-byte encodings, whose character boundaries
+# have to be found by decoding. At least three of the four sampled
+# chunks start in the middle of the corpus, so they all have to be
+# decoded, and the alphabet of the sample has to be the same
+# as the alphabet of the whole corpus, without any characters
+# decoded from the middle of a character.
+
+RSGEN="${1:-./rsgen}"
+TMPDIR="$(mktemp -d)" || exit 1
+trap 'rm -rf "$TMPDIR"' EXIT
+
+JAPANESE="あいうえおかきくけこさしすせそ漢字日本語東京大学"
+KOREAN="가각간갈감강개거건걸검것게겨결경고공과관광교구국군권\
+그근글금기길김나날남내너년노놀누는늘니다단달담당대더데도독동되\
+된두드들등디라락란람랑래러레려력로록론료루류르른를름리린릴림립"
+
+failed=0
+
+# check <name> <alphabet> <encoding>
+check () {
+	expected=$(($(printf '%s' "$2" | iconv -f UTF-8 -t UCS-4 | wc -c) / 4))
+	"$RSGEN" -a "$2" -l 2500000 --seed 1 "$TMPDIR/$1.utf8" \
+		>/dev/null || return 1
+	iconv -f UTF-8 -t "$3" "$TMPDIR/$1.utf8" >"$TMPDIR/$1" || return 1
+	"$RSGEN" -f "$TMPDIR/$1" -i "$3" --sample-corpus 4M -l 1 -v \
+		"$TMPDIR/$1.out" >"$TMPDIR/$1.log" 2>&1
+	actual="$(sed -n 's/^Total alphabet size: //p' "$TMPDIR/$1.log")"
+	sampled="$(sed -n 's/^Sampled \([0-9]*\) bytes.*/\1/p' \
+		"$TMPDIR/$1.log")"
+	if [ "$actual" != "$expected" ]; then
+		echo "FAIL $1 ($3): alphabet size '$actual'," \
+			"expected $expected"
+		failed=1
+	elif [ "${sampled:-0}" -lt 3145728 ]; then
+		echo "FAIL $1 ($3): sampled only '$sampled' bytes"
+		failed=1
+	else
+		echo "PASS $1 ($3)"
+	fi
+}
+
+check sjis "$JAPANESE" SHIFT_JIS || failed=1
+check eucjp "$JAPANESE" EUC-JP || failed=1
+check gb18030 "$JAPANESE" GB18030 || failed=1
+check euckr "$KOREAN" EUC-KR || failed=1
+
+exit $failed